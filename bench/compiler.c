@@ -0,0 +1,76 @@
+/* Compiler throughput benchmark.
+ * Generates one long expression of about 4 MiB mixing
+ * numbers, grouping, arithmetic, comparisons, keywords and
+ * comments, and times compile() over it: scanning, parsing,
+ * constant folding and code emission together.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "compiler.h"
+
+#define SOURCE_SIZE (4 << 20)
+#define PASSES 5
+
+
+/* Appends terms joined by operators until size bytes are
+ * used. Returns the source length.
+ */
+static size_t make_source(char *source, size_t size) {
+    static const char *terms[] = {
+        "(12.5 + 3) * 4",
+        "7 / (2 + 1)",
+        "1024 - 768.25",
+        "(3 < 4) == (5 >= 2)",
+        "not false == true",
+        "-(99 * 0.5)",
+        "NULL == NULL",
+        "// a comment between terms\n 42",
+    };
+    static const char *ops[] = { " + ", " - ", " * ", " == ", " != ", " / " };
+    const int term_count = sizeof(terms) / sizeof(terms[0]);
+    const int op_count = sizeof(ops) / sizeof(ops[0]);
+    uint32_t seed = 12345;
+    size_t length = 0;
+    for(int i = 0;; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        const char *op = i == 0 ? "" : ops[(seed >> 8) % op_count];
+        const char *term = terms[(seed >> 16) % term_count];
+        size_t needed = strlen(op) + strlen(term) + 1;
+        if(length + needed > size) break;
+        length += sprintf(source + length, "%s%s%s", op, term, i % 8 == 7 ? "\n" : "");
+    }
+    return length;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    char *source = malloc(SOURCE_SIZE + 1);
+    size_t length = make_source(source, SOURCE_SIZE);
+
+    Heap heap;
+    init_heap(&heap);
+    Table globals;
+    init_table(&globals);
+    int code_size = 0;
+    double start = bench_now();
+    for(int pass = 0; pass < PASSES; pass++) {
+        Chunk chunk;
+        init_chunk(&chunk);
+        if(!compile(source, length, &chunk, &heap, &globals, stderr)) return bench_finish(1);
+        code_size = chunk.count;
+        free_chunk(&chunk);
+    }
+    double elapsed = bench_now() - start;
+
+    double rate = (double)length * PASSES / elapsed / 1048576.0;
+    fprintf(bench_report(), "compiler: %.1f MiB source to %d bytes of code, %.1f ms per compile, %.0f MiB/s\n",
+        length / 1048576.0, code_size, elapsed * 1e3 / PASSES, rate);
+    bench_record("compiler", "source", rate, "MiB/s", HIGHER_IS_BETTER);
+
+    free_heap(&heap);
+    free(source);
+    return bench_finish(0);
+}
@@ -0,0 +1,43 @@
+/* Constant pool benchmark.
+ * Grows fresh chunks to a full 16-bit pool of distinct
+ * numbers through add_constant(), then looks every value up
+ * again, which must hit the deduplication index.
+ */
+#include <stdio.h>
+#include "bench.h"
+#include "chunk.h"
+
+#define CONSTANTS (MAX_REPRESENTABLE_CONST + 1)
+#define ROUNDS 40
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    double adding = 0;
+    double finding = 0;
+    for(int round = 0; round < ROUNDS; round++) {
+        Chunk chunk;
+        init_chunk(&chunk);
+
+        double start = bench_now();
+        for(int i = 0; i < CONSTANTS; i++) add_constant(&chunk, NUMBER_VAL(i * 0.25 + round));
+        adding += bench_now() - start;
+
+        start = bench_now();
+        for(int i = 0; i < CONSTANTS; i++) {
+            if(add_constant(&chunk, NUMBER_VAL(i * 0.25 + round)) != (size_t)i) {
+                fprintf(stderr, "constants: duplicate %d was not found\n", i);
+                return bench_finish(1);
+            }
+        }
+        finding += bench_now() - start;
+        free_chunk(&chunk);
+    }
+
+    double operations = (double)CONSTANTS * ROUNDS;
+    fprintf(bench_report(), "constants: %d-entry pools x %d, add %.1f M/s, dedup lookup %.1f M/s\n",
+        CONSTANTS, ROUNDS, operations / adding / 1e6, operations / finding / 1e6);
+    bench_record("constants", "add", operations / adding / 1e6, "M/s", HIGHER_IS_BETTER);
+    bench_record("constants", "lookup", operations / finding / 1e6, "M/s", HIGHER_IS_BETTER);
+    return bench_finish(0);
+}
@@ -0,0 +1,85 @@
+/* End-to-end corpus benchmark.
+ * Runs every .grino script in bench/corpus through
+ * interpret(), compiling and executing it from the source
+ * text each time, and reports milliseconds per run. The
+ * scripts are the workloads the PGO build trains on too.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "source.h"
+#include "vm.h"
+
+#define CORPUS_DIR "bench/corpus"
+#define MAX_SCRIPTS 256
+#define MIN_TIME 0.25 // seconds spent on each script
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    bench_silence_stdout();
+
+    DIR *dir = opendir(CORPUS_DIR);
+    if(dir == NULL) {
+        fprintf(stderr, "corpus: cannot open %s (run from the repository root)\n", CORPUS_DIR);
+        return bench_finish(1);
+    }
+    char *names[MAX_SCRIPTS];
+    int count = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL && count < MAX_SCRIPTS) {
+        size_t length = strlen(entry->d_name);
+        if(length > 6 && strcmp(entry->d_name + length - 6, ".grino") == 0) {
+            names[count++] = strdup(entry->d_name);
+        }
+    }
+    closedir(dir);
+    qsort(names, count, sizeof(char *), compare_names);
+
+    VM vm;
+    init_vm(&vm);
+    int status = 0;
+    for(int i = 0; i < count && status == 0; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", CORPUS_DIR, names[i]);
+        Source source;
+        if(!open_source(&source, path)) {
+            fprintf(stderr, "corpus: cannot read %s\n", path);
+            status = 1;
+            break;
+        }
+
+        int runs = 0;
+        double start = bench_now();
+        double elapsed;
+        do {
+            if(interpret(&vm, source.text, source.length) != INTERPRET_OK) {
+                fprintf(stderr, "corpus: %s failed\n", path);
+                status = 1;
+                break;
+            }
+            runs += 1;
+            elapsed = bench_now() - start;
+        } while(elapsed < MIN_TIME);
+
+        if(status == 0) {
+            double ms = elapsed * 1e3 / runs;
+            fprintf(bench_report(), "corpus %-18s %7.1f KiB %8.3f ms/run %7.0f MiB/s\n",
+                names[i], source.length / 1024.0, ms, source.length / (ms / 1e3) / 1048576.0);
+            *strrchr(names[i], '.') = '\0';
+            bench_record("corpus", names[i], ms, "ms", LOWER_IS_BETTER);
+        }
+        close_source(&source);
+    }
+    free_vm(&vm);
+
+    for(int i = 0; i < count; i++) free(names[i]);
+    return bench_finish(status);
+}
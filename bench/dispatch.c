@@ -0,0 +1,69 @@
+/* Dispatch microbenchmark.
+ * Assembles the chunk for one long arithmetic expression
+ * and runs it repeatedly through interpret_chunk(),
+ * reporting executed instructions per second. The chunk is
+ * written directly because the compiler would fold it to a
+ * single constant. Build with DEFS=-DGRINO_SWITCH_DISPATCH
+ * to measure the switch loop.
+ */
+#include <stdio.h>
+#include "bench.h"
+#include "vm.h"
+
+#define TERMS 20000
+#define RUNS 1000
+
+/* Writes the code for "1 + 2 * 3 - 4 / 5 + ..." with the
+ * given number of terms, evaluated left to right.
+ */
+static void make_chunk(Chunk *chunk, int terms) {
+    static const OpCode ops[] = { OP_ADD, OP_MULTIPLY, OP_SUBTRACT, OP_DIVIDE };
+    for(int i = 0; i < terms; i++) {
+        write_constant(chunk, NUMBER_VAL(i % 97 + 1), 1);
+        if(i > 0) write_chunk(chunk, ops[i % 4], 1);
+    }
+    write_chunk(chunk, OP_RETURN, 1);
+    chunk->max_stack = 2;
+}
+
+
+static long count_instructions(Chunk *chunk) {
+    long count = 0;
+    for(int offset = 0; offset < chunk->count; count++) {
+        offset += instruction_length(chunk->code[offset]);
+    }
+    return count;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    bench_silence_stdout();
+
+    Chunk chunk;
+    init_chunk(&chunk);
+    make_chunk(&chunk, TERMS);
+
+    VM vm;
+    init_vm(&vm);
+    long instructions = count_instructions(&chunk);
+    double start = bench_now();
+    for(int i = 0; i < RUNS; i++) {
+        if(interpret_chunk(&vm, &chunk) != INTERPRET_OK) return bench_finish(1);
+    }
+    double elapsed = bench_now() - start;
+    free_vm(&vm);
+
+    #ifdef COMPUTED_GOTO
+    const char *mode = "computed-goto";
+    #else
+    const char *mode = "switch";
+    #endif
+    double rate = instructions * (double)RUNS / elapsed / 1e6;
+    fprintf(bench_report(), "dispatch (%s): %ld instructions x %d runs in %.3fs, %.1f M instr/s\n",
+        mode, instructions, RUNS, elapsed, rate);
+    bench_record("dispatch", "instructions", rate, "M instr/s", HIGHER_IS_BETTER);
+
+    free_chunk(&chunk);
+    return bench_finish(0);
+}
@@ -0,0 +1,136 @@
+/* Garbage collector benchmark.
+ * Runs a script that builds a new string in almost every
+ * statement and drops the one before, keeping a slowly
+ * growing string alive, once with the incremental collector
+ * and once with every collection done in a single step.
+ * Each run gets a fresh VM, so no run finds the strings of
+ * the one before still interned.
+ * Reports the longest and mean pause, the share of the run
+ * spent collecting and the peak heap against everything
+ * allocated, and checks both runs return the same string.
+ * Also checks that the register VM collects the same
+ * script's garbage.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "grino.h"
+#include "regvm.h"
+
+#define RUNS 5
+#define STATEMENTS 200000
+#define KEEP_EVERY 1000
+
+/* var a = "key"; var keep = ""; var t;
+ * t = a + "17" + "/3"; ... keep = keep + t; ... keep
+ */
+static char *make_source(void) {
+    size_t size = STATEMENTS * 40 + 128;
+    char *source = malloc(size);
+    size_t length = snprintf(source, size, "var a = \"key\";\nvar keep = \"\";\nvar t;\n");
+    for(int i = 0; i < STATEMENTS; i++) {
+        length += snprintf(source + length, size - length, "t = a + \"%d\" + \"/%d\";\n",
+            i % 400, i / 400);
+        if(i % KEEP_EVERY == 0) {
+            length += snprintf(source + length, size - length, "keep = keep + t;\n");
+        }
+    }
+    snprintf(source + length, size - length, "keep\n");
+    return source;
+}
+
+
+/* Adds the figures of one run to total. */
+static void add_stats(GcStats *total, const GcStats *run) {
+    total->cycles += run->cycles;
+    total->steps += run->steps;
+    total->pause_total_ns += run->pause_total_ns;
+    if(run->pause_max_ns > total->pause_max_ns) total->pause_max_ns = run->pause_max_ns;
+    total->bytes_allocated += run->bytes_allocated;
+    if(run->peak_bytes > total->peak_bytes) total->peak_bytes = run->peak_bytes;
+}
+
+
+static int run_collector(Program *program, const char *name, size_t step_work,
+    ObjString **kept) {
+    gc_options.step_work = step_work;
+    GcStats totals = {0};
+    bool same = true;
+    double elapsed = 0;
+    for(int i = 0; i < RUNS && same; i++) {
+        VM vm;
+        init_vm(&vm);
+        Value result = NULL_VAL;
+        double start = bench_now();
+        InterpretResult status = run_program(&vm, program, &result);
+        elapsed += bench_now() - start;
+        same = status == INTERPRET_OK && IS_STRING(result);
+        if(same) {
+            // Compared by contents: each VM interns its own copy.
+            ObjString *string = AS_STRING(result);
+            same = *kept == NULL || ((*kept)->length == string->length &&
+                memcmp((*kept)->chars, string->chars, string->length) == 0);
+            if(*kept == NULL) *kept = copy_string(&program->heap, string->chars, string->length);
+        }
+        add_stats(&totals, &vm.heap.gc.stats);
+        free_vm(&vm);
+    }
+
+    GcStats *stats = &totals;
+    double pause_max = stats->pause_max_ns / 1e6;
+    double pause_mean = stats->steps > 0 ? stats->pause_total_ns / 1e6 / stats->steps : 0;
+    double share = 100.0 * stats->pause_total_ns / 1e9 / elapsed;
+    fprintf(bench_report(), "gc %-11s %3llu collections in %5llu steps | pause max %6.3f ms, "
+        "mean %6.3f ms | %4.1f%% of %7.2f ms | peak %6.0f KiB, %7.0f KiB allocated\n", name,
+        (unsigned long long)stats->cycles, (unsigned long long)stats->steps, pause_max,
+        pause_mean, share, elapsed * 1e3, stats->peak_bytes / 1024.0,
+        stats->bytes_allocated / 1024.0);
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_pause_max", name);
+    bench_record("gc", metric, pause_max, "ms", LOWER_IS_BETTER);
+    snprintf(metric, sizeof(metric), "%s_run", name);
+    bench_record("gc", metric, elapsed * 1e3 / RUNS, "ms", LOWER_IS_BETTER);
+    return same && stats->cycles > 0 ? 0 : 1;
+}
+
+
+/* Runs the script once on the register VM, whose output is
+ * silenced, and returns 1 unless a collection freed memory.
+ */
+static int run_registers(const char *source) {
+    VM vm;
+    init_vm(&vm);
+    bool ok = interpret_registers(&vm, source, strlen(source)) == INTERPRET_OK;
+    GcStats *stats = &vm.heap.gc.stats;
+    fprintf(bench_report(), "gc registers  %3llu collections in %5llu steps | "
+        "%7.0f KiB freed of %7.0f KiB allocated\n", (unsigned long long)stats->cycles,
+        (unsigned long long)stats->steps, stats->bytes_freed / 1024.0,
+        stats->bytes_allocated / 1024.0);
+    ok = ok && stats->cycles > 0 && stats->bytes_freed > 0;
+    free_vm(&vm);
+    if(!ok) fprintf(stderr, "gc: the register VM freed nothing\n");
+    return ok ? 0 : 1;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    bench_silence_stdout();
+    char *source = make_source();
+    Program *program = compile_program(source, strlen(source), stderr);
+    int failed = program == NULL || run_registers(source);
+    free(source);
+    if(failed) {
+        if(program != NULL) free_program(program);
+        return bench_finish(1);
+    }
+
+    ObjString *kept = NULL;
+    size_t step_work = gc_options.step_work;
+    failed = run_collector(program, "incremental", step_work, &kept) ||
+        run_collector(program, "stop-world", 0, &kept);
+    gc_options.step_work = step_work;
+    free_program(program);
+    return bench_finish(failed);
+}
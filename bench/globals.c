@@ -0,0 +1,91 @@
+/* Global variable benchmark.
+ * Compiles a script that declares a few globals and then
+ * sums them over and over, and times its runs through
+ * run_program(), where each read is one OP_GET_GLOBAL. For
+ * comparison it also times looking the same names up by
+ * name in the compiler's table, the least a name-keyed
+ * global would cost per read, with no VM around it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "grino.h"
+
+#define RUNS 500
+#define GLOBALS 8
+#define READS 20000
+
+static const char *names[GLOBALS] = {
+    "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta",
+};
+
+
+/* var alpha = 1; ... alpha + beta + ... */
+static char *make_source(void) {
+    size_t size = GLOBALS * 32 + READS * 12;
+    char *source = malloc(size);
+    size_t length = 0;
+    for(int i = 0; i < GLOBALS; i++) {
+        length += snprintf(source + length, size - length, "var %s = %d;\n", names[i], i + 1);
+    }
+    for(int i = 0; i < READS; i++) {
+        length += snprintf(source + length, size - length, i > 0 ? " + %s" : "%s",
+            names[i * 5 % GLOBALS]);
+    }
+    return source;
+}
+
+
+static int64_t expected_sum(void) {
+    int64_t sum = 0;
+    for(int i = 0; i < READS; i++) sum += i * 5 % GLOBALS + 1;
+    return sum;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    char *source = make_source();
+    Program *program = compile_program(source, strlen(source), stderr);
+    free(source);
+    if(program == NULL) return bench_finish(1);
+
+    VM vm;
+    init_vm(&vm);
+    Value result = NULL_VAL;
+    bool failed = false;
+    double start = bench_now();
+    for(int i = 0; i < RUNS && !failed; i++) {
+        failed = run_program(&vm, program, &result) != INTERPRET_OK;
+    }
+    double slots = (bench_now() - start) / RUNS;
+    failed = failed || !IS_INT(result) || AS_INT(result) != expected_sum();
+
+    ObjString *keys[GLOBALS];
+    for(int i = 0; i < GLOBALS; i++) {
+        keys[i] = copy_string(&program->heap, names[i], strlen(names[i]));
+    }
+    int64_t checksum = 0;
+    start = bench_now();
+    for(int run = 0; run < RUNS; run++) {
+        for(int i = 0; i < READS; i++) {
+            Value slot;
+            table_get(&program->globals, keys[i * 5 % GLOBALS], &slot);
+            checksum += AS_INT(slot);
+        }
+    }
+    double hashed = (bench_now() - start) / RUNS;
+    free_vm(&vm);
+    free_program(program);
+    if(failed) {
+        fprintf(stderr, "globals: expected a sum of %lld\n", (long long)expected_sum());
+        return bench_finish(1);
+    }
+
+    fprintf(bench_report(), "globals: %d reads in %.3f ms, %.2f ns per read and add | "
+        "table lookups alone %.2f ns per read (checksum %lld)\n", READS, slots * 1e3,
+        slots / READS * 1e9, hashed / READS * 1e9, (long long)checksum);
+    bench_record("globals", "read", slots / READS * 1e9, "ns/op", LOWER_IS_BETTER);
+    return bench_finish(0);
+}
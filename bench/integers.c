@@ -0,0 +1,125 @@
+/* Integer arithmetic benchmark.
+ * Assembles the same aggregation shapes twice, once with int
+ * constants and once with the equal doubles, and times both
+ * through the VM. The constant folder would reduce them to
+ * one value, so they are written as if their operands were
+ * variables. The int sum is also checked against C.
+ */
+#include <stdio.h>
+#include "bench.h"
+#include "compiler.h"
+#include "vm.h"
+
+#define RUNS 500
+#define TERMS 20000
+
+typedef void (*Shape)(Chunk *chunk, bool integers);
+
+static void constant(Chunk *chunk, bool integers, int64_t value) {
+    write_constant(chunk, integers ? INT_VAL(value) : NUMBER_VAL((double)value), 1);
+}
+
+
+static int64_t term(int i) {
+    return (int64_t)i * 7919 % 100003;
+}
+
+
+/* t0 + t1 + t2 + ... */
+static void sum(Chunk *chunk, bool integers) {
+    for(int i = 0; i < TERMS; i++) {
+        constant(chunk, integers, term(i));
+        if(i > 0) write_chunk(chunk, OP_ADD, 1);
+    }
+    chunk->max_stack = 2;
+}
+
+
+/* t0 * 3 - t1 + t2 * 3 - t3 + ... */
+static void weighted(Chunk *chunk, bool integers) {
+    for(int i = 0; i < TERMS; i++) {
+        constant(chunk, integers, term(i));
+        if(i % 2 == 0) {
+            constant(chunk, integers, 3);
+            write_chunk(chunk, OP_MULTIPLY, 1);
+        }
+        if(i > 0) write_chunk(chunk, i % 2 ? OP_SUBTRACT : OP_ADD, 1);
+    }
+    chunk->max_stack = 3;
+}
+
+
+/* (t0 < t1) == (t2 >= t3) == ... */
+static void comparisons(Chunk *chunk, bool integers) {
+    for(int i = 0; i < TERMS / 2; i++) {
+        constant(chunk, integers, term(2 * i));
+        constant(chunk, integers, term(2 * i + 1));
+        write_chunk(chunk, i % 2 ? OP_GREATER_EQUAL : OP_LESS, 1);
+        if(i > 0) write_chunk(chunk, OP_EQUAL, 1);
+    }
+    chunk->max_stack = 3;
+}
+
+
+static double time_shape(VM *vm, Shape shape, bool integers, Value *result) {
+    Chunk chunk;
+    init_chunk(&chunk);
+    shape(&chunk, integers);
+    write_chunk(&chunk, OP_RETURN, 1);
+    select_superinstructions(&chunk);
+
+    double start = bench_now();
+    for(int i = 0; i < RUNS; i++) {
+        if(run_chunk(vm, &chunk, result) != INTERPRET_OK) {
+            free_chunk(&chunk);
+            return -1;
+        }
+    }
+    double elapsed = (bench_now() - start) * 1e3 / RUNS;
+    free_chunk(&chunk);
+    return elapsed;
+}
+
+
+static int run_shape(VM *vm, const char *name, Shape shape) {
+    Value int_result;
+    Value double_result;
+    double int_time = time_shape(vm, shape, true, &int_result);
+    double double_time = time_shape(vm, shape, false, &double_result);
+    if(int_time < 0 || double_time < 0) return 1;
+    if(!values_equal(int_result, double_result)) {
+        fprintf(stderr, "integers %s: int and double results differ\n", name);
+        return 1;
+    }
+
+    fprintf(bench_report(), "integers %-12s double %6.3f ms | int %6.3f ms | %.2fx\n",
+        name, double_time, int_time, double_time / int_time);
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_int", name);
+    bench_record("integers", metric, int_time, "ms", LOWER_IS_BETTER);
+    snprintf(metric, sizeof(metric), "%s_double", name);
+    bench_record("integers", metric, double_time, "ms", LOWER_IS_BETTER);
+    return 0;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+
+    VM vm;
+    init_vm(&vm);
+    int failed = run_shape(&vm, "sum", sum) ||
+        run_shape(&vm, "weighted", weighted) ||
+        run_shape(&vm, "comparisons", comparisons);
+
+    Value result;
+    int64_t expected = 0;
+    for(int i = 0; i < TERMS; i++) expected += term(i);
+    if(!failed && (time_shape(&vm, sum, true, &result) < 0 || !IS_INT(result) ||
+        AS_INT(result) != expected)) {
+        fprintf(stderr, "integers sum: expected %lld\n", (long long)expected);
+        failed = 1;
+    }
+    free_vm(&vm);
+    return bench_finish(failed);
+}
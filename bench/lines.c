@@ -0,0 +1,52 @@
+/* Line table benchmark.
+ * Writes a 4 MiB chunk whose line changes every 1-8 bytes,
+ * then measures random get_line() lookups, as a runtime
+ * error would do, and a LineCursor walk over every offset,
+ * as the disassembler does.
+ */
+#include <stdio.h>
+#include "bench.h"
+#include "chunk.h"
+
+#define CODE_SIZE (4 << 20)
+#define LOOKUPS 10000000
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    Chunk chunk;
+    init_chunk(&chunk);
+    uint32_t seed = 12345;
+    int line = 1;
+    while(chunk.count < CODE_SIZE) {
+        seed = seed * 1664525u + 1013904223u;
+        int run = 1 + (seed >> 16) % 8;
+        for(int i = 0; i < run; i++) write_chunk(&chunk, OP_NEGATE, line);
+        line += 1;
+    }
+
+    long checksum = 0;
+    double start = bench_now();
+    for(int i = 0; i < LOOKUPS; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        checksum += get_line(&chunk, (seed >> 4) % chunk.count);
+    }
+    double random = bench_now() - start;
+
+    LineCursor cursor;
+    init_line_cursor(&cursor, &chunk);
+    start = bench_now();
+    for(int offset = 0; offset < chunk.count; offset++) {
+        checksum += cursor_line(&cursor, offset);
+    }
+    double sequential = bench_now() - start;
+
+    fprintf(bench_report(), "lines: %d runs over %d bytes, get_line %.1f M/s, cursor %.1f M/s (checksum %ld)\n",
+        chunk.line_count, chunk.count, LOOKUPS / random / 1e6,
+        chunk.count / sequential / 1e6, checksum);
+    bench_record("lines", "get_line", LOOKUPS / random / 1e6, "M/s", HIGHER_IS_BETTER);
+    bench_record("lines", "cursor", chunk.count / sequential / 1e6, "M/s", HIGHER_IS_BETTER);
+
+    free_chunk(&chunk);
+    return bench_finish(0);
+}
@@ -0,0 +1,174 @@
+/* Numeric literal benchmark.
+ * Generates number tokens of the scanner's shape (digits,
+ * optionally '.' and digits): short integers, decimals, long
+ * significands past 19 digits, and values deep in the
+ * subnormal and overflow ranges. Every literal is first
+ * checked bit for bit against strtod(); any mismatch fails
+ * the run. Then both parsers are timed over the whole set
+ * and over the short integers and decimals typical of data
+ * files.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "number.h"
+
+#define LITERALS 200000
+#define PASSES 20
+#define MAX_LITERAL 400
+
+typedef struct {
+    const char *start;
+    size_t length;
+} Literal;
+
+static uint32_t seed = 12345;
+
+static uint32_t next_random() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+
+static size_t random_digits(char *out, int count, bool leading_nonzero) {
+    for(int i = 0; i < count; i++) {
+        out[i] = '0' + next_random() % 10;
+    }
+    if(leading_nonzero && count > 0 && out[0] == '0') out[0] = '1';
+    return count;
+}
+
+
+/* Writes one literal of the given kind (0-5, see below)
+ * into out and returns its length.
+ */
+static size_t make_literal(char *out, int kind) {
+    size_t length = 0;
+    switch(kind) {
+        case 0: // integer
+            length = random_digits(out, 1 + next_random() % 20, true);
+            break;
+        case 1: // everyday decimal
+            length = random_digits(out, 1 + next_random() % 6, true);
+            out[length++] = '.';
+            length += random_digits(out + length, 1 + next_random() % 8, false);
+            break;
+        case 2: // long significand
+            length = random_digits(out, 1 + next_random() % 20, true);
+            out[length++] = '.';
+            length += random_digits(out + length, 10 + next_random() % 30, false);
+            break;
+        case 3: { // small and subnormal
+            out[length++] = '0';
+            out[length++] = '.';
+            int zeros = next_random() % 340;
+            memset(out + length, '0', zeros);
+            length += zeros;
+            length += random_digits(out + length, 1 + next_random() % 25, true);
+            break;
+        }
+        case 4: // large and overflowing
+            length = random_digits(out, 280 + next_random() % 40, true);
+            break;
+        default: { // near a tie: 17 digits then a 5 and zeros
+            length = random_digits(out, 16, true);
+            out[length++] = '5';
+            int zeros = next_random() % 20;
+            memset(out + length, '0', zeros);
+            length += zeros;
+            break;
+        }
+    }
+    return length;
+}
+
+
+static const char *hard_cases[] = {
+    "0", "0.0", "1", "0.1", "0.3", "9007199254740992", "9007199254740993",
+    "9007199254740995", "18446744073709551615", "18446744073709551616",
+    "123456789012345678901234567890", "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "1.00000000000000011102230246251565404236316680908203126",
+    "2.2250738585072011", "0.000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000022250738585072011",
+    "0.0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "4940656458412465441765687928682213723651",
+    "179769313486231580793728971405303415079934132710037826936173778980444968292764750946649017977587207"
+    "096330286416692887910946555547851940402630657488671505820681908902000708383676273854845817711531764"
+    "475730270069855571366959622842914819860834936475292719074168444365510704342711559699508093042880177"
+    "904174497791.9999999999999999999999999999999999999999999999999999999999999999999999",
+};
+
+
+static bool same_bits(double left, double right) {
+    return memcmp(&left, &right, sizeof(double)) == 0;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    const int hard_count = sizeof(hard_cases) / sizeof(hard_cases[0]);
+    int count = LITERALS + hard_count;
+    char *text = malloc((size_t)LITERALS * MAX_LITERAL);
+    Literal *literals = malloc(count * sizeof(Literal));
+    size_t bytes = 0;
+    for(int i = 0; i < hard_count; i++) {
+        literals[i].start = hard_cases[i];
+        literals[i].length = strlen(hard_cases[i]);
+    }
+    for(int i = hard_count; i < count; i++) {
+        literals[i].start = text + bytes;
+        // The first half are typical, the rest any kind.
+        int kind = i < count / 2 ? next_random() % 2 : next_random() % 6;
+        literals[i].length = make_literal(text + bytes, kind);
+        bytes += literals[i].length;
+    }
+
+    for(int i = 0; i < count; i++) {
+        double expected = parse_number_strtod(literals[i].start, literals[i].length);
+        double parsed = parse_number(literals[i].start, literals[i].length);
+        if(!same_bits(parsed, expected)) {
+            fprintf(stderr, "literals: %.*s parsed as %.17g, strtod gives %.17g\n",
+                (int)literals[i].length, literals[i].start, parsed, expected);
+            return bench_finish(1);
+        }
+    }
+
+    printf("literals: %d checked against strtod\n", count);
+    double sum = 0;
+    for(int set = 0; set < 2; set++) {
+        const char *name = set == 0 ? "typical" : "mixed";
+        Literal *first = set == 0 ? literals + hard_count : literals + count / 2;
+        int n = set == 0 ? count / 2 - hard_count : count - count / 2;
+
+        double start = bench_now();
+        for(int pass = 0; pass < PASSES; pass++) {
+            for(int i = 0; i < n; i++) sum += parse_number(first[i].start, first[i].length);
+        }
+        double fast = bench_now() - start;
+
+        start = bench_now();
+        for(int pass = 0; pass < PASSES; pass++) {
+            for(int i = 0; i < n; i++) sum += parse_number_strtod(first[i].start, first[i].length);
+        }
+        double slow = bench_now() - start;
+
+        double parsed = (double)n * PASSES;
+        printf("literals (%s): parse_number %.1f M literals/s, strtod %.1f M literals/s\n",
+            name, parsed / fast / 1e6, parsed / slow / 1e6);
+        bench_record("literals", name, parsed / fast / 1e6, "M literals/s", HIGHER_IS_BETTER);
+    }
+    printf("literals: checksum %g\n", sum);
+
+    free(literals);
+    free(text);
+    return bench_finish(0);
+}
@@ -0,0 +1,121 @@
+/* Local variable benchmark.
+ * Compiles the same sum over a few variables twice, once
+ * with the variables declared inside a block, where each
+ * read is an OP_GET_LOCAL, and once as globals, and times
+ * both through run_program(). The heap must not grow while
+ * either runs. Also checks that a block with MAX_LOCALS
+ * locals pops all of them, which takes more than one
+ * OP_POPN.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "compiler.h"
+#include "grino.h"
+
+#define RUNS 500
+#define VARIABLES 8
+#define READS 20000
+
+static const char *names[VARIABLES] = {
+    "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta",
+};
+
+
+/* var sum; { var alpha = 1; ... sum = alpha + beta + ...; } sum */
+static char *make_source(bool locals) {
+    size_t size = VARIABLES * 32 + READS * 12 + 64;
+    char *source = malloc(size);
+    size_t length = snprintf(source, size, "var sum;\n%s", locals ? "{\n" : "");
+    for(int i = 0; i < VARIABLES; i++) {
+        length += snprintf(source + length, size - length, "var %s = %d;\n", names[i], i + 1);
+    }
+    length += snprintf(source + length, size - length, "sum = ");
+    for(int i = 0; i < READS; i++) {
+        length += snprintf(source + length, size - length, i > 0 ? " + %s" : "%s",
+            names[i * 5 % VARIABLES]);
+    }
+    snprintf(source + length, size - length, ";\n%ssum\n", locals ? "}\n" : "");
+    return source;
+}
+
+
+static int64_t expected_sum(void) {
+    int64_t sum = 0;
+    for(int i = 0; i < READS; i++) sum += i * 5 % VARIABLES + 1;
+    return sum;
+}
+
+
+/* var g = 1; { var v0 = 0; ... g = v0 + v255; } g + 1
+ * A local the block leaves behind is still on the stack
+ * once the script returns, and the push after the block
+ * goes past the reserved stack.
+ */
+static bool run_full_block(VM *vm) {
+    size_t size = MAX_LOCALS * 24 + 64;
+    char *source = malloc(size);
+    size_t length = snprintf(source, size, "var g = 1;\n{\n");
+    for(int i = 0; i < MAX_LOCALS; i++) {
+        length += snprintf(source + length, size - length, "var v%d = %d;\n", i, i);
+    }
+    snprintf(source + length, size - length, "g = v0 + v%d;\n}\ng + 1\n", MAX_LOCALS - 1);
+    Program *program = compile_program(source, strlen(source), stderr);
+    free(source);
+    if(program == NULL) return false;
+
+    Value result = NULL_VAL;
+    bool passed = run_program(vm, program, &result) == INTERPRET_OK &&
+        IS_INT(result) && AS_INT(result) == MAX_LOCALS && vm->stack.top == vm->stack.data;
+    free_program(program);
+    return passed;
+}
+
+
+/* Returns the milliseconds per run, or -1 on failure. */
+static double time_program(VM *vm, bool locals) {
+    char *source = make_source(locals);
+    Program *program = compile_program(source, strlen(source), stderr);
+    free(source);
+    if(program == NULL) return -1;
+
+    Value result = NULL_VAL;
+    bool failed = run_program(vm, program, &result) != INTERPRET_OK;
+    size_t bytes = vm->heap.bytes_allocated;
+    double start = bench_now();
+    for(int i = 0; i < RUNS && !failed; i++) {
+        failed = run_program(vm, program, &result) != INTERPRET_OK;
+    }
+    double elapsed = (bench_now() - start) * 1e3 / RUNS;
+    failed = failed || !IS_INT(result) || AS_INT(result) != expected_sum() ||
+        vm->heap.bytes_allocated != bytes;
+    free_program(program);
+    return failed ? -1 : elapsed;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    VM vm;
+    init_vm(&vm);
+    double local_time = time_program(&vm, true);
+    double global_time = time_program(&vm, false);
+    bool full_block = run_full_block(&vm);
+    free_vm(&vm);
+    if(!full_block) {
+        fprintf(stderr, "locals: a block of %d locals did not return %d with an empty stack\n",
+            MAX_LOCALS, MAX_LOCALS);
+        return bench_finish(1);
+    }
+    if(local_time < 0 || global_time < 0) {
+        fprintf(stderr, "locals: expected a sum of %lld\n", (long long)expected_sum());
+        return bench_finish(1);
+    }
+
+    fprintf(bench_report(), "locals: %d reads, globals %.3f ms | locals %.3f ms, "
+        "%.2f ns per read and add | %.2fx\n", READS, global_time, local_time,
+        local_time * 1e6 / READS, global_time / local_time);
+    bench_record("locals", "read", local_time * 1e6 / READS, "ns/op", LOWER_IS_BETTER);
+    return bench_finish(0);
+}
@@ -0,0 +1,51 @@
+/* Compile-once benchmark.
+ * Evaluates the same short expression over and over, once
+ * through interpret(), which scans and compiles it on every
+ * call, and once through a Program compiled up front and
+ * run with run_program() on a reused VM. The expression is
+ * the size of a typical embedded rule.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "grino.h"
+
+#define EVALUATIONS 2000000
+
+static const char expression[] =
+    "(120.5 * 4 - 3) / 2 >= 20 == not (7 * 6 != 42 - 0.0)";
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    bench_silence_stdout();
+    size_t length = strlen(expression);
+
+    VM vm;
+    init_vm(&vm);
+    double start = bench_now();
+    for(int i = 0; i < EVALUATIONS; i++) {
+        if(interpret(&vm, expression, length) != INTERPRET_OK) return bench_finish(1);
+    }
+    double interpreted = bench_now() - start;
+
+    Program *program = compile_program(expression, length, stderr);
+    if(program == NULL) return bench_finish(1);
+    Value value = NULL_VAL;
+    start = bench_now();
+    for(int i = 0; i < EVALUATIONS; i++) {
+        if(run_program(&vm, program, &value) != INTERPRET_OK) return bench_finish(1);
+    }
+    double compiled_once = bench_now() - start;
+    free_program(program);
+    free_vm(&vm);
+    if(!IS_BOOL(value) || !AS_BOOL(value)) return bench_finish(1);
+
+    double interpret_rate = EVALUATIONS / interpreted / 1e6;
+    double program_rate = EVALUATIONS / compiled_once / 1e6;
+    fprintf(bench_report(), "program: interpret %.2f M evals/s, run_program %.2f M evals/s, %.1fx\n",
+        interpret_rate, program_rate, program_rate / interpret_rate);
+    bench_record("program", "interpret", interpret_rate, "M evals/s", HIGHER_IS_BETTER);
+    bench_record("program", "run_program", program_rate, "M evals/s", HIGHER_IS_BETTER);
+    return bench_finish(0);
+}
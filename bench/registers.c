@@ -0,0 +1,133 @@
+/* Stack versus register VM benchmark.
+ * Assembles a small corpus of expression shapes as stack
+ * chunks, lowers each with lower_to_registers(), and runs
+ * both forms, reporting instruction counts and wall time.
+ * The chunks are written directly because the compiler
+ * would fold literal-only expressions to one constant.
+ */
+#include <stdio.h>
+#include "bench.h"
+#include "compiler.h"
+#include "regvm.h"
+#include "vm.h"
+
+#define RUNS 500
+
+static int next_constant = 0;
+
+static void constant(Chunk *chunk) {
+    write_constant(chunk, NUMBER_VAL(next_constant++ % 97 + 1), 1);
+}
+
+
+/* 1 + 2 * 3 - 4 / 5 + ... evaluated left to right. */
+static void chain(Chunk *chunk) {
+    static const OpCode ops[] = { OP_ADD, OP_MULTIPLY, OP_SUBTRACT, OP_DIVIDE };
+    for(int i = 0; i < 20000; i++) {
+        constant(chunk);
+        if(i > 0) write_chunk(chunk, ops[i % 4], 1);
+    }
+    chunk->max_stack = 2;
+}
+
+
+/* ((1 + 2) * (3 - 4)) + ... as a complete binary tree. */
+static void tree_of_depth(Chunk *chunk, int depth) {
+    static const OpCode ops[] = { OP_ADD, OP_MULTIPLY, OP_SUBTRACT };
+    if(depth == 0) {
+        constant(chunk);
+        return;
+    }
+    tree_of_depth(chunk, depth - 1);
+    tree_of_depth(chunk, depth - 1);
+    write_chunk(chunk, ops[depth % 3], 1);
+}
+
+static void tree(Chunk *chunk) {
+    tree_of_depth(chunk, 14);
+    chunk->max_stack = 15;
+}
+
+
+/* (1 < 2) == (3 >= 4) != (5 <= 6) == ... */
+static void comparisons(Chunk *chunk) {
+    static const OpCode tests[] = { OP_LESS, OP_GREATER_EQUAL, OP_LESS_EQUAL, OP_GREATER };
+    for(int i = 0; i < 8000; i++) {
+        constant(chunk);
+        constant(chunk);
+        write_chunk(chunk, tests[i % 4], 1);
+        if(i > 0) write_chunk(chunk, i % 2 ? OP_EQUAL : OP_NOT_EQUAL, 1);
+    }
+    chunk->max_stack = 3;
+}
+
+
+static long count_stack_instructions(Chunk *chunk) {
+    long count = 0;
+    for(int offset = 0; offset < chunk->count; count++) {
+        offset += instruction_length(chunk->code[offset]);
+    }
+    return count;
+}
+
+
+static long count_register_instructions(RegisterChunk *chunk) {
+    long count = 0;
+    for(int offset = 0; offset < chunk->chunk.count; count++) {
+        offset += register_instruction_length(chunk->chunk.code[offset]);
+    }
+    return count;
+}
+
+
+static int run_shape(VM *vm, const char *name, void (*shape)(Chunk *)) {
+    Chunk chunk;
+    init_chunk(&chunk);
+    shape(&chunk);
+    write_chunk(&chunk, OP_RETURN, 1);
+
+    RegisterChunk registers;
+    init_register_chunk(&registers);
+    if(!lower_to_registers(&chunk, &registers, stderr)) return 1;
+
+    double start = bench_now();
+    for(int i = 0; i < RUNS; i++) {
+        if(interpret_chunk(vm, &chunk) != INTERPRET_OK) return 1;
+    }
+    double stack_time = bench_now() - start;
+
+    start = bench_now();
+    for(int i = 0; i < RUNS; i++) {
+        if(run_register_chunk(vm, &registers) != INTERPRET_OK) return 1;
+    }
+    double register_time = bench_now() - start;
+
+    fprintf(bench_report(), "registers %-12s stack: %6ld instr %7.2f ms | register: %6ld instr %7.2f ms (%d regs) | %.2fx\n",
+        name, count_stack_instructions(&chunk), stack_time * 1e3 / RUNS,
+        count_register_instructions(&registers), register_time * 1e3 / RUNS,
+        registers.register_count, stack_time / register_time);
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_stack", name);
+    bench_record("registers", metric, stack_time * 1e3 / RUNS, "ms", LOWER_IS_BETTER);
+    snprintf(metric, sizeof(metric), "%s_register", name);
+    bench_record("registers", metric, register_time * 1e3 / RUNS, "ms", LOWER_IS_BETTER);
+
+    free_register_chunk(&registers);
+    free_chunk(&chunk);
+    return 0;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    bench_silence_stdout();
+
+    VM vm;
+    init_vm(&vm);
+    int failed = run_shape(&vm, "chain", chain) ||
+        run_shape(&vm, "tree", tree) ||
+        run_shape(&vm, "comparisons", comparisons);
+    free_vm(&vm);
+
+    return bench_finish(failed);
+}
@@ -0,0 +1,93 @@
+/* Scanner throughput benchmark.
+ * Generates a multi-megabyte source of identifiers, keywords,
+ * numbers, strings, comments and operators, then scans it to
+ * TOKEN_EOF repeatedly and reports tokens per second. Build
+ * with DEFS=-DGRINO_SCALAR_SCANNER to measure the scalar
+ * loops, or DEFS=-mavx2 for the 32-byte fast paths.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "scanner.h"
+
+#define SOURCE_SIZE (8 << 20)
+#define PASSES 10
+
+/* Appends statement-like lines until size bytes are used.
+ * Returns the number of the last line.
+ */
+static int make_source(char *source, size_t size) {
+    static const char *pieces[] = {
+        "var total_count = previous_value + 12345.678;\n",
+        "    print \"a string literal with some words in it\";\n",
+        "// a comment line that the scanner skips entirely\n",
+        "if (left_operand <= right_operand and not done) {\n",
+        "\t\tresult = (alpha * 42 - beta / 7) != gamma_delta;\n",
+        "}\n",
+        "\"a string that\nspans two lines\" + 3.25;\n",
+        "        \n",
+    };
+    const int piece_count = sizeof(pieces) / sizeof(pieces[0]);
+    uint32_t seed = 12345;
+    size_t length = 0;
+    int line = 1;
+    for(;;) {
+        seed = seed * 1664525u + 1013904223u;
+        const char *piece = pieces[(seed >> 16) % piece_count];
+        size_t piece_length = strlen(piece);
+        if(length + piece_length > size) break;
+        memcpy(source + length, piece, piece_length);
+        length += piece_length;
+        for(size_t i = 0; i < piece_length; i++) line += piece[i] == '\n';
+    }
+    memset(source + length, ' ', size - length);
+    return line;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    char *source = malloc(SOURCE_SIZE);
+    int last_line = make_source(source, SOURCE_SIZE);
+
+    long tokens = 0;
+    double start = bench_now();
+    for(int pass = 0; pass < PASSES; pass++) {
+        Scanner scanner;
+        init_scanner(&scanner, source, SOURCE_SIZE);
+        for(;;) {
+            Token token = scan_token(&scanner);
+            if(token.type == TOKEN_ERROR) {
+                fprintf(stderr, "scanner: %.*s on line %d\n",
+                    token.length, token.start, token.line);
+                return bench_finish(1);
+            }
+            tokens += 1;
+            if(token.type == TOKEN_EOF) {
+                if(token.line != last_line) {
+                    fprintf(stderr, "scanner: ended on line %d, expected %d\n",
+                        token.line, last_line);
+                    return bench_finish(1);
+                }
+                break;
+            }
+        }
+    }
+    double elapsed = bench_now() - start;
+
+    #if defined(SCANNER_AVX2)
+    const char *mode = "avx2";
+    #elif defined(SCANNER_SSE2)
+    const char *mode = "sse2";
+    #else
+    const char *mode = "scalar";
+    #endif
+    printf("scanner (%s): %ld tokens from %d MiB x %d passes in %.3fs, %.1f M tokens/s, %.0f MiB/s\n",
+        mode, tokens / PASSES, SOURCE_SIZE >> 20, PASSES, elapsed,
+        tokens / elapsed / 1e6, (double)SOURCE_SIZE * PASSES / elapsed / 1048576.0);
+    bench_record("scanner", "tokens", tokens / elapsed / 1e6, "M tokens/s", HIGHER_IS_BETTER);
+
+    free(source);
+    return bench_finish(0);
+}
@@ -0,0 +1,112 @@
+/* String benchmark.
+ * Assembles string workloads the constant folder cannot
+ * reduce, as if their operands were variables:
+ *
+ *   keys     "key" + "17" == "key17" == ..., a concatenation
+ *            that finds its result already interned and a
+ *            pointer comparison per key
+ *   build    "ab" + "ab" + ..., one new string per step, all
+ *            but the last garbage once the next is built
+ *
+ * and times them through the VM's OP_ADD and OP_EQUAL. Later
+ * runs of keys must allocate nothing; build allocates again
+ * whatever the collector freed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "compiler.h"
+#include "vm.h"
+
+#define RUNS 200
+#define KEYS 4000
+#define PIECES 2000
+
+static void string_constant(Chunk *chunk, Heap *heap, const char *text) {
+    write_constant(chunk, OBJ_VAL(copy_string(heap, text, strlen(text))), 1);
+}
+
+
+static void keys(Chunk *chunk, Heap *heap) {
+    for(int i = 0; i < KEYS; i++) {
+        char suffix[16];
+        char key[32];
+        snprintf(suffix, sizeof(suffix), "%d", i % 500);
+        snprintf(key, sizeof(key), "key%s", suffix);
+        string_constant(chunk, heap, "key");
+        string_constant(chunk, heap, suffix);
+        write_chunk(chunk, OP_ADD, 1);
+        string_constant(chunk, heap, key);
+        write_chunk(chunk, OP_EQUAL, 1);
+        if(i > 0) write_chunk(chunk, OP_EQUAL, 1);
+    }
+    chunk->max_stack = 4;
+}
+
+
+static bool keys_matched(Value result) {
+    return IS_BOOL(result) && AS_BOOL(result);
+}
+
+
+static void build(Chunk *chunk, Heap *heap) {
+    for(int i = 0; i < PIECES; i++) {
+        string_constant(chunk, heap, "ab");
+        if(i > 0) write_chunk(chunk, OP_ADD, 1);
+    }
+    chunk->max_stack = 2;
+}
+
+
+static bool built(Value result) {
+    return IS_STRING(result) && AS_STRING(result)->length == 2 * PIECES;
+}
+
+
+/* The first run interns every result; later runs find those
+ * the collector has kept.
+ */
+static int run_shape(const char *name, void (*shape)(Chunk *, Heap *),
+    bool (*correct)(Value), bool interned, int operations) {
+    VM vm;
+    init_vm(&vm);
+    Chunk chunk;
+    init_chunk(&chunk);
+    shape(&chunk, &vm.heap);
+    write_chunk(&chunk, OP_RETURN, 1);
+    select_superinstructions(&chunk);
+
+    Value result;
+    double start = bench_now();
+    bool failed = run_chunk(&vm, &chunk, &result) != INTERPRET_OK;
+    double first = bench_now() - start;
+    size_t bytes = vm.heap.bytes_allocated;
+
+    start = bench_now();
+    for(int i = 0; i < RUNS && !failed; i++) {
+        failed = run_chunk(&vm, &chunk, &result) != INTERPRET_OK;
+    }
+    double later = (bench_now() - start) / RUNS;
+    failed = failed || !correct(result) || (interned && vm.heap.bytes_allocated != bytes);
+    free_chunk(&chunk);
+    free_vm(&vm);
+    if(failed) return 1;
+
+    fprintf(bench_report(), "strings %-6s first run %7.3f ms | later %7.3f ms, %.1f ns/op | "
+        "%zu KiB of strings\n", name, first * 1e3, later * 1e3, later / operations * 1e9,
+        bytes / 1024);
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_first", name);
+    bench_record("strings", metric, first * 1e3, "ms", LOWER_IS_BETTER);
+    snprintf(metric, sizeof(metric), "%s_interned", name);
+    bench_record("strings", metric, later / operations * 1e9, "ns/op", LOWER_IS_BETTER);
+    return 0;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    int failed = run_shape("keys", keys, keys_matched, true, KEYS) ||
+        run_shape("build", build, built, false, PIECES);
+    return bench_finish(failed);
+}
@@ -0,0 +1,158 @@
+/* Superinstruction benchmark.
+ * Assembles expression shapes the constant folder cannot
+ * reduce, as if their operands were variables, and runs
+ * each before and after select_superinstructions(). Reports
+ * the executed dispatches, counted through the VM's profile
+ * hook, and the wall time of both forms. The corpus scripts
+ * are left out: they fold to a single constant.
+ *
+ * The opcode pairs of the unfused runs are written to
+ * bin/superinstructions.json. Copying that file over
+ * tools/superinstructions.json and rebuilding retrains the
+ * generated set.
+ */
+#include <stdio.h>
+#include "bench.h"
+#include "compiler.h"
+#include "vm.h"
+
+#define RUNS 500
+#define PROFILE_PATH "bin/superinstructions.json"
+
+static int next_constant = 0;
+static Profile recorded; // pairs of every unfused run
+
+static void constant(Chunk *chunk) {
+    write_constant(chunk, NUMBER_VAL(next_constant++ % 97 + 1), 1);
+}
+
+
+/* 1 + 2 * 3 - 4 / 5 + ... evaluated left to right. */
+static void chain(Chunk *chunk) {
+    static const OpCode ops[] = { OP_ADD, OP_MULTIPLY, OP_SUBTRACT, OP_DIVIDE };
+    for(int i = 0; i < 20000; i++) {
+        constant(chunk);
+        if(i > 0) write_chunk(chunk, ops[i % 4], 1);
+    }
+    chunk->max_stack = 2;
+}
+
+
+/* ((1 + 2) * (3 - 4)) + ... as a complete binary tree. */
+static void tree_of_depth(Chunk *chunk, int depth) {
+    static const OpCode ops[] = { OP_ADD, OP_MULTIPLY, OP_SUBTRACT };
+    if(depth == 0) {
+        constant(chunk);
+        return;
+    }
+    tree_of_depth(chunk, depth - 1);
+    tree_of_depth(chunk, depth - 1);
+    write_chunk(chunk, ops[depth % 3], 1);
+}
+
+static void tree(Chunk *chunk) {
+    tree_of_depth(chunk, 14);
+    chunk->max_stack = 15;
+}
+
+
+/* (1 < 2) == (3 >= 4) != (5 <= 6) == ... */
+static void comparisons(Chunk *chunk) {
+    static const OpCode tests[] = { OP_LESS, OP_GREATER_EQUAL, OP_LESS_EQUAL, OP_GREATER };
+    for(int i = 0; i < 8000; i++) {
+        constant(chunk);
+        constant(chunk);
+        write_chunk(chunk, tests[i % 4], 1);
+        if(i > 0) write_chunk(chunk, i % 2 ? OP_EQUAL : OP_NOT_EQUAL, 1);
+    }
+    chunk->max_stack = 3;
+}
+
+
+/* not (1 == 2) == not (3 < 4) == ... */
+static void negations(Chunk *chunk) {
+    for(int i = 0; i < 8000; i++) {
+        constant(chunk);
+        constant(chunk);
+        write_chunk(chunk, i % 2 ? OP_EQUAL : OP_LESS, 1);
+        write_chunk(chunk, OP_NOT, 1);
+        if(i > 0) write_chunk(chunk, OP_EQUAL, 1);
+    }
+    chunk->max_stack = 3;
+}
+
+
+/* Runs chunk once with the profile hook on and returns the
+ * number of dispatches it took.
+ */
+static uint64_t count_dispatches(VM *vm, Chunk *chunk, Profile *profile) {
+    uint64_t before = profile->instructions;
+    set_vm_profile(vm, profile);
+    Value result;
+    InterpretResult status = run_chunk(vm, chunk, &result);
+    set_vm_profile(vm, NULL);
+    return status == INTERPRET_OK ? profile->instructions - before : 0;
+}
+
+
+static double time_runs(VM *vm, Chunk *chunk) {
+    double start = bench_now();
+    for(int i = 0; i < RUNS; i++) {
+        if(interpret_chunk(vm, chunk) != INTERPRET_OK) return -1;
+    }
+    return (bench_now() - start) * 1e3 / RUNS;
+}
+
+
+static int run_shape(VM *vm, const char *name, void (*shape)(Chunk *)) {
+    Chunk chunk;
+    init_chunk(&chunk);
+    shape(&chunk);
+    write_chunk(&chunk, OP_RETURN, 1);
+
+    uint64_t plain_dispatches = count_dispatches(vm, &chunk, &recorded);
+    double plain_time = time_runs(vm, &chunk);
+
+    select_superinstructions(&chunk);
+    static Profile scratch;
+    init_profile(&scratch);
+    uint64_t fused_dispatches = count_dispatches(vm, &chunk, &scratch);
+    double fused_time = time_runs(vm, &chunk);
+    free_chunk(&chunk);
+    if(plain_dispatches == 0 || fused_dispatches == 0 || plain_time < 0 || fused_time < 0) return 1;
+
+    double saved = 100.0 * (plain_dispatches - fused_dispatches) / plain_dispatches;
+    fprintf(bench_report(), "superinstructions %-12s dispatches %6llu -> %6llu (-%4.1f%%) | "
+        "%6.3f -> %6.3f ms | %.2fx\n", name, (unsigned long long)plain_dispatches,
+        (unsigned long long)fused_dispatches, saved, plain_time, fused_time,
+        plain_time / fused_time);
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_dispatches_saved", name);
+    bench_record("superinstructions", metric, saved, "%", HIGHER_IS_BETTER);
+    snprintf(metric, sizeof(metric), "%s_fused", name);
+    bench_record("superinstructions", metric, fused_time, "ms", LOWER_IS_BETTER);
+    return 0;
+}
+
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    bench_silence_stdout();
+    init_profile(&recorded);
+
+    VM vm;
+    init_vm(&vm);
+    int failed = run_shape(&vm, "chain", chain) ||
+        run_shape(&vm, "tree", tree) ||
+        run_shape(&vm, "comparisons", comparisons) ||
+        run_shape(&vm, "negations", negations);
+    free_vm(&vm);
+
+    FILE *file = fopen(PROFILE_PATH, "w");
+    if(file == NULL || !write_profile_json(&recorded, file)) {
+        fprintf(stderr, "superinstructions: could not write %s\n", PROFILE_PATH);
+        failed = 1;
+    }
+    if(file != NULL) fclose(file);
+    return bench_finish(failed);
+}
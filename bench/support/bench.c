@@ -0,0 +1,69 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+
+static FILE *report = NULL;
+static FILE *json = NULL;
+
+
+void bench_init(int argc, const char *argv[]) {
+    report = stdout;
+    for(int arg = 1; arg < argc; arg++) {
+        if(strcmp(argv[arg], "--json") == 0 && arg + 1 < argc) {
+            json = fopen(argv[++arg], "a");
+            if(json == NULL) {
+                fprintf(stderr, "Could not open \"%s\".\n", argv[arg]);
+                exit(1);
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--json FILE]\n", argv[0]);
+            exit(64);
+        }
+    }
+}
+
+
+double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+FILE *bench_report() {
+    return report;
+}
+
+
+/* The VM prints the result of every execution; benchmarks
+ * that run it send stdout to /dev/null and keep reporting
+ * through a duplicate of the original descriptor.
+ */
+void bench_silence_stdout() {
+    fflush(stdout);
+    FILE *copy = fdopen(dup(STDOUT_FILENO), "w");
+    if(copy == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        fprintf(stderr, "Could not redirect stdout.\n");
+        exit(1);
+    }
+    report = copy;
+}
+
+
+void bench_record(const char *bench, const char *metric, double value,
+    const char *unit, BenchDirection direction) {
+    if(json == NULL) return;
+    fprintf(json, "{\"bench\": \"%s\", \"metric\": \"%s\", \"value\": %.6g, "
+        "\"unit\": \"%s\", \"better\": \"%s\"}\n", bench, metric, value, unit,
+        direction == HIGHER_IS_BETTER ? "higher" : "lower");
+}
+
+
+int bench_finish(int status) {
+    if(json != NULL) fclose(json);
+    if(report != stdout) fclose(report);
+    return status;
+}
@@ -0,0 +1,27 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include "common.h"
+
+/* Shared by every benchmark in bench/. Human-readable lines
+ * go to the report stream; each measured figure is also
+ * recorded with bench_record(), which appends one JSON
+ * object per line to the file named by "--json FILE".
+ * make bench joins those lines into a JSON array and
+ * tools/bench_compare.c compares two such arrays.
+ */
+typedef enum {
+    LOWER_IS_BETTER,
+    HIGHER_IS_BETTER
+} BenchDirection;
+
+void bench_init(int argc, const char *argv[]);
+double bench_now();
+FILE *bench_report();
+void bench_silence_stdout();
+void bench_record(const char *bench, const char *metric, double value,
+    const char *unit, BenchDirection direction);
+int bench_finish(int status);
+
+#endif
@@ -0,0 +1,75 @@
+/* Value representation benchmark.
+ * Fills a ValueArray much larger than the last-level cache
+ * and measures a sequential sweep and a random gather over
+ * it. Compare a default build against DEFS=-DNAN_BOXING;
+ * for cache-miss counts run it under
+ * make bench BENCH_RUN="perf stat -e cache-misses".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "value.h"
+
+#define VALUES (1 << 23)
+#define PASSES 8
+
+int main(int argc, const char *argv[]) {
+    bench_init(argc, argv);
+    ValueArray array;
+    init_value_array(&array);
+    /* write_value_array caps a constant pool at 16 bits, so
+       the array is filled directly. */
+    array.values = reallocate(NULL, 0, VALUES * sizeof(Value));
+    array.capacity = array.count = VALUES;
+    for(int i = 0; i < VALUES; i++) {
+        switch(i % 8) {
+            case 0:  array.values[i] = NULL_VAL; break;
+            case 1:  array.values[i] = BOOL_VAL(i % 3 == 0); break;
+            default: array.values[i] = NUMBER_VAL(i * 0.5); break;
+        }
+    }
+
+    uint32_t *order = malloc(VALUES * sizeof(uint32_t));
+    uint32_t seed = 12345;
+    for(int i = 0; i < VALUES; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        order[i] = seed % VALUES;
+    }
+
+    double sum = 0;
+    double start = bench_now();
+    for(int pass = 0; pass < PASSES; pass++) {
+        for(int i = 0; i < VALUES; i++) {
+            Value value = array.values[i];
+            if(IS_DOUBLE(value)) sum += AS_DOUBLE(value);
+            else if(IS_BOOL(value) && AS_BOOL(value)) sum += 1;
+        }
+    }
+    double sweep = bench_now() - start;
+
+    start = bench_now();
+    for(int pass = 0; pass < PASSES; pass++) {
+        for(int i = 0; i < VALUES; i++) {
+            Value value = array.values[order[i]];
+            if(IS_DOUBLE(value)) sum += AS_DOUBLE(value);
+        }
+    }
+    double gather = bench_now() - start;
+
+    #ifdef NAN_BOXING
+    const char *mode = "nan-boxing";
+    #else
+    const char *mode = "tagged-union";
+    #endif
+    double touched = (double)VALUES * PASSES;
+    printf("values (%s): sizeof(Value) = %zu, working set %.0f MiB\n",
+        mode, sizeof(Value), VALUES * sizeof(Value) / 1048576.0);
+    printf("values (%s): sweep %.2f ns/value, gather %.2f ns/value (checksum %g)\n",
+        mode, sweep / touched * 1e9, gather / touched * 1e9, sum);
+    bench_record("values", "sweep", sweep / touched * 1e9, "ns/value", LOWER_IS_BETTER);
+    bench_record("values", "gather", gather / touched * 1e9, "ns/value", LOWER_IS_BETTER);
+
+    free(order);
+    free_value_array(&array);
+    return bench_finish(0);
+}
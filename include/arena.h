@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "common.h"
+#include "memory.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t capacity;
+    size_t used;
+} ArenaBlock;
+
+/* Bump-pointer allocator for everything one compilation
+ * produces. Blocks come from reallocate() and are kept
+ * across reset_arena(), so a warmed-up arena compiles
+ * without touching the libc allocator.
+ */
+typedef struct {
+    ArenaBlock *first;
+    ArenaBlock *current;
+    size_t in_use;      // bytes handed out since the last reset
+    size_t high_water;  // largest in_use ever reached
+    size_t reserved;    // bytes held in blocks
+    int blocks;
+    int resets;
+} Arena;
+
+void init_arena(Arena *arena);
+void reset_arena(Arena *arena);
+void free_arena(Arena *arena);
+void *arena_reallocate(Arena *arena, void *pointer, size_t old_size, size_t new_size);
+void print_arena_report(Arena *arena, const char *name, FILE *out);
+
+#endif
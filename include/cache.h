@@ -0,0 +1,33 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "chunk.h"
+#include "common.h"
+#include "vm.h"
+
+/* Bump whenever the file layout, the opcode numbering or
+ * the constant encoding changes; older files are ignored.
+ */
+#define CACHE_VERSION 9
+#define CACHE_ALIGNMENT 4096 // code section starts on a page
+
+/* A chunk loaded from a cache file. Its code and line table
+ * point into the read-only mapping of the file, so they stay
+ * valid until free_cached_chunk().
+ */
+typedef struct {
+    Chunk chunk;
+    void *mapping;
+    size_t mapping_size;
+} CachedChunk;
+
+uint64_t hash_source(const char *source, size_t length);
+bool load_cached_chunk(CachedChunk *cached, Heap *heap, Table *globals,
+    const char *cache_path, const char *source, size_t length);
+void free_cached_chunk(CachedChunk *cached);
+bool write_cached_chunk(Chunk *chunk, const Table *globals, const char *cache_path,
+    const char *source, size_t length);
+InterpretResult interpret_cached(VM *vm, const char *source, size_t length,
+    const char *cache_path);
+
+#endif
@@ -5,39 +5,79 @@
 #include "memory.h"
 #include "value.h"
 
+/* Base opcodes come from opcodes.def. Superinstructions
+ * follow them: each runs two base instructions with one
+ * dispatch, and takes the operand of the first. The set is
+ * generated from a recorded opcode-pair profile into
+ * obj/gen/superinstructions.h.
+ */
 typedef enum {
-    OP_RETURN,
-    OP_CONSTANT,
-    OP_CONSTANT_LONG,
-    OP_NEGATE,
-    OP_ADD,
-    OP_SUBTRACT,
-    OP_MULTIPLY,
-    OP_DIVIDE,
-    OP_NULL,
-    OP_TRUE,
-    OP_FALSE,
-    OP_NOT,
-    OP_EQUAL,
-    OP_GREATER,
-    OP_LESS,
+#define OPCODE(name, operand) name,
+#include "opcodes.def"
+#undef OPCODE
+#define SUPERINSTRUCTION(name, first, second, operand) name,
+#include "superinstructions.h"
+#undef SUPERINSTRUCTION
+    OP_COUNT // number of opcodes, not an instruction
 } OpCode;
 
+typedef enum {
+    OPERAND_NONE,
+    OPERAND_CONSTANT,      // 8-bit constant index
+    OPERAND_CONSTANT_LONG, // 16-bit big-endian constant index
+    OPERAND_GLOBAL,        // 16-bit big-endian global slot
+    OPERAND_LOCAL,         // 8-bit stack slot
+    OPERAND_COUNT,         // 8-bit number of values
+} OperandKind;
+
+/* Start of a run of bytecode emitted from the same source
+ * line. Chunk.lines holds these sorted by offset, one entry
+ * per run, so lookups can binary search.
+ */
+typedef struct {
+    int offset;
+    int line;
+} LineStart;
+
+/* constant_slots is an open-addressing hash index over
+ * constants: each slot holds an index into constants.values
+ * or -1 when empty. add_constant() uses it to hand back the
+ * existing index for a value that is already in the pool.
+ */
 typedef struct {
     int count;
     int capacity;
-    int *lines;
+    LineStart *lines;
     int line_count;
     int line_capacity;
     uint8_t *code;
     ValueArray constants;
+    int *constant_slots;
+    int constant_slot_capacity;
+    int max_stack; // deepest stack the code reaches
+    int global_count; // global slots the code may refer to
+    Arena *arena; // NULL allocates through reallocate()
+    bool borrowed; // code and lines live in a cache mapping
 } Chunk;
 
+/* Walks the line table alongside a forward scan of the
+ * code, so sequential lookups cost O(1) amortized.
+ */
+typedef struct {
+    Chunk *chunk;
+    int index;
+} LineCursor;
+
 void init_chunk(Chunk *chunk);
+void init_chunk_in_arena(Chunk *chunk, Arena *arena);
 void write_chunk(Chunk *chunk, uint8_t byte, int line);
 void free_chunk(Chunk *chunk);
 int get_line(Chunk *chunk, int offset);
+void init_line_cursor(LineCursor *cursor, Chunk *chunk);
+int cursor_line(LineCursor *cursor, int offset);
 void write_constant(Chunk *chunk, Value value, int line);
 size_t add_constant(Chunk *chunk, Value value);
+OperandKind opcode_operand(uint8_t opcode);
+int instruction_length(uint8_t opcode);
 
 #endif
\ No newline at end of file
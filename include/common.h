@@ -7,7 +7,12 @@
 #include <assert.h>
 #include <stdint.h>
 
-#define DEBUG_TRACE_EXECUTION
-#define DEBUG_PRINT_CODE
+/* Threaded dispatch in run() relies on the GCC/Clang
+ * labels-as-values extension. Build with
+ * -DGRINO_SWITCH_DISPATCH to force the portable switch.
+ */
+#if defined(__GNUC__) && !defined(GRINO_SWITCH_DISPATCH)
+#define COMPUTED_GOTO
+#endif
 
 #endif 
\ No newline at end of file
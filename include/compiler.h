@@ -2,18 +2,58 @@
 #define COMPILER_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "vm.h"
+#include "regvm.h"
 #include "scanner.h"
 
-typedef void (*ParseFn)();
+typedef struct Parser Parser;
 
+typedef void (*ParseFn)(Parser*, bool can_assign);
+
+#define MAX_PENDING_CONSTANTS 64
+#define MAX_LOCALS (UINT8_MAX + 1) // slots a one-byte operand can reach
+
+/* A constant operand whose load has not been emitted yet.
+ * Keeping it pending lets unary() and binary() fold
+ * operations on literals at compile time.
+ */
 typedef struct {
+    Value value;
+    int line;
+} PendingConstant;
+
+/* A variable declared inside a block. Its slot is its index
+ * in the parser's locals, which is also where its value sits
+ * on the VM stack. depth is -1 until its initializer has
+ * been compiled.
+ */
+typedef struct {
+    Token name;
+    int depth;
+} Local;
+
+/* Everything one compilation touches. compile() keeps it on
+ * its own stack.
+ */
+struct Parser {
+    Scanner scanner;
+    FILE* errors;
+    Heap* heap; // where string constants are allocated
+    Table* globals; // global name -> slot, shared by every chunk that runs together
+    bool superinstructions; // fuse opcode pairs once compiled
     Chunk* compiling_chunk;
     Token current;
     Token previous;
     bool had_error;
     bool panic_mode;
-} Parser;
+    PendingConstant pending[MAX_PENDING_CONSTANTS];
+    int pending_count;
+    int stack_height;
+    Local locals[MAX_LOCALS];
+    int local_count;
+    int scope_depth; // 0 at the top level, where var declares globals
+};
 
 typedef enum {
   PREC_NONE,
@@ -35,7 +75,12 @@ typedef struct {
     Precedence precedence;
 } ParseRule;
 
-bool compile(const char* source, Chunk* chunk);
+bool compile(const char* source, size_t length, Chunk* chunk, Heap* heap, Table* globals,
+    FILE* errors);
+bool compile_registers(const char* source, size_t length, RegisterChunk* chunk, Heap* heap,
+    Table* globals, FILE* errors);
+bool lower_to_registers(Chunk* source, RegisterChunk* target, FILE* errors);
+void select_superinstructions(Chunk* chunk);
 
 
 #endif
@@ -5,6 +5,17 @@
 #include "chunk.h"
 #include "value.h"
 
+/* Diagnostics switched on at runtime, e.g. from the
+ * command line. Both are off by default.
+ */
+typedef struct {
+    bool print_code;        // disassemble each compiled chunk
+    bool trace_execution;   // print the stack and each instruction
+} DebugOptions;
+
+extern DebugOptions debug_options;
+
+const char *opcode_name(int opcode);
 void disassemble_chunk(Chunk *chunk, const char *name);
 int disassemble_instruction(Chunk *chunk, int offset);
 
@@ -0,0 +1,87 @@
+#ifndef GC_H
+#define GC_H
+
+#include "common.h"
+#include "table.h"
+#include "value.h"
+
+#define GC_HEAP_GROWTH_FACTOR 2.0 // next collection starts at live bytes times this
+#define GC_MIN_HEAP (1024 * 1024) // no collection below this many bytes of objects
+#define GC_STEP_SIZE (64 * 1024) // bytes allocated between steps of a collection
+#define GC_STEP_WORK 4096 // objects and root values visited per step
+#define INITIAL_GRAY_SIZE 64
+#define GRAY_GROWTH_FACTOR 2
+
+typedef struct Heap Heap;
+
+/* Collector settings shared by every VM, e.g. from the
+ * command line.
+ */
+typedef struct {
+    double growth_factor;
+    size_t step_work; // 0 runs each collection in one step
+} GcOptions;
+
+extern GcOptions gc_options;
+
+typedef enum {
+    GC_IDLE,
+    GC_MARK,
+    GC_SWEEP,
+} GcPhase;
+
+typedef struct {
+    uint64_t cycles;
+    uint64_t steps;
+    uint64_t pause_total_ns;
+    uint64_t pause_max_ns;
+    uint64_t bytes_allocated; // over the heap's whole life
+    uint64_t bytes_freed;
+    size_t peak_bytes;
+    uint64_t started_ns; // when the heap was created
+} GcStats;
+
+/* Incremental tri-color mark-sweep state of one heap. A
+ * collection starts once the heap outgrows next_step and
+ * then does a bounded slice of work every GC_STEP_SIZE bytes
+ * until it is done. Marking walks the roots with cursors so
+ * it can stop anywhere; sweeping keeps a pointer to the link
+ * of the next object to look at.
+ */
+typedef struct {
+    GcPhase phase;
+    size_t next_step; // bytes_allocated that triggers the next step
+    Obj **gray; // reached objects whose references are not traced yet
+    int gray_count;
+    int gray_capacity;
+    const Entry *names_entries; // table the names cursor walks
+    int names_index;
+    int globals_index;
+    int constants_index;
+    Obj **sweep;
+    GcStats stats;
+} Collector;
+
+/* What a collection must keep alive, described by the VM
+ * that owns the heap each time it takes a step. Objects of
+ * other heaps, such as a program's constants, are never
+ * marked or freed.
+ */
+typedef struct {
+    Value *stack;
+    int stack_count;
+    Value *globals;
+    int global_count;
+    const Table *names; // global name -> slot
+    const ValueArray *constants; // of the running chunk, or NULL
+} Roots;
+
+void init_collector(Collector *gc);
+void free_collector(Collector *gc);
+void mark_object(Heap *heap, Obj *object);
+void mark_value(Heap *heap, Value value);
+void restart_constant_scan(Heap *heap);
+void collect_step(Heap *heap, const Roots *roots);
+void print_gc_stats(Heap *heap, FILE *out);
+
+#endif
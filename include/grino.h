@@ -0,0 +1,22 @@
+#ifndef GRINO_H
+#define GRINO_H
+
+/* Embedding API, built as libgrino by "make lib":
+ *
+ *   VM vm;
+ *   init_vm(&vm);
+ *   Program *program = compile_program(source, length, stderr);
+ *   Value value;
+ *   if(program != NULL && run_program(&vm, program, &value) == INTERPRET_OK) {
+ *       ... IS_INT(value), AS_INT(value), IS_NUMBER(value), ...
+ *   }
+ *   free_program(program);
+ *   free_vm(&vm);
+ *
+ * A VM runs one program at a time; use one VM per thread.
+ */
+#include "program.h"
+#include "value.h"
+#include "vm.h"
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include "common.h"
+
+/* Converts a number token (digits, optionally followed by
+ * '.' and more digits) to the nearest double, reading only
+ * length bytes. The result is correctly rounded and
+ * independent of the locale.
+ */
+double parse_number(const char *start, size_t length);
+double parse_number_strtod(const char *start, size_t length);
+
+/* Converts a number token without a '.' to an integer.
+ * Returns false if it has one or does not fit an int64_t.
+ */
+bool parse_integer(const char *start, size_t length, int64_t *value);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "common.h"
+#include "gc.h"
+#include "table.h"
+#include "value.h"
+
+#define OBJ_TYPE(value)     (AS_OBJ(value)->type)
+#define IS_STRING(value)    is_obj_type(value, OBJ_STRING)
+#define AS_STRING(value)    ((ObjString*)AS_OBJ(value))
+#define AS_CSTRING(value)   (AS_STRING(value)->chars)
+
+typedef enum {
+    OBJ_STRING,
+} ObjType;
+
+typedef enum {
+    GC_WHITE, // not reached by the current collection
+    GC_GRAY, // reached, its references not traced yet
+    GC_BLACK, // reached and traced
+    GC_PERMANENT, // never collected or written, e.g. a program's
+} GcColor;
+
+struct Obj {
+    ObjType type;
+    uint8_t color; // a GcColor
+    struct Obj *next; // the owning heap's object list
+};
+
+/* The characters follow the header in the same allocation
+ * and are NUL-terminated. Strings are immutable and interned,
+ * so two strings are equal only if they are the same object.
+ */
+struct ObjString {
+    Obj obj;
+    uint32_t length;
+    uint32_t hash; // FNV-1a of the characters
+    char chars[];
+};
+
+/* Owns every object allocated through it and the table that
+ * interns its strings. Each VM has one, and so does each
+ * Program for its constants. A VM's heap is collected while
+ * the VM runs; a permanent heap, like a Program's, keeps its
+ * objects until it is freed and never writes to them again.
+ * The interned strings are weak: a string only the table
+ * refers to is collected and leaves the table.
+ */
+struct Heap {
+    Obj *objects;
+    Table strings;
+    /* Strings of the program being run, interned first so
+       its constants stay the only copies. Read-only, since
+       several VMs may run the program at once. */
+    const Table *program_strings;
+    size_t bytes_allocated; // by the live objects, through reallocate()
+    bool permanent;
+    Collector gc;
+};
+
+void init_heap(Heap *heap);
+void free_heap(Heap *heap);
+void free_object(Heap *heap, Obj *object);
+uint32_t hash_string(uint32_t hash, const char *chars, size_t length);
+ObjString *copy_string(Heap *heap, const char *chars, size_t length);
+ObjString *concatenate_strings(Heap *heap, ObjString *a, ObjString *b);
+void print_object(FILE *out, Value value);
+
+#define EMPTY_STRING_HASH 2166136261u
+
+static inline bool is_obj_type(Value value, ObjType type) {
+    return IS_OBJ(value) && OBJ_TYPE(value) == type;
+}
+
+#endif
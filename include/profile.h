@@ -0,0 +1,24 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include "chunk.h"
+#include "common.h"
+
+/* Execution counters collected by the VM's instruction
+ * hook: how often each opcode ran and how often each
+ * opcode directly followed another.
+ */
+typedef struct {
+    uint64_t instructions;
+    uint64_t opcodes[OP_COUNT];
+    uint64_t pairs[OP_COUNT][OP_COUNT];
+    int previous; // last opcode in the current run, or -1
+} Profile;
+
+void init_profile(Profile *profile);
+void profile_start_run(Profile *profile);
+void profile_instruction(Profile *profile, uint8_t opcode);
+bool write_profile_json(Profile *profile, FILE *out);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "chunk.h"
+#include "vm.h"
+
+/* A script compiled once and run any number of times.
+ * Running never writes to the program, so one program may
+ * run on several VMs, in several threads, at once. Its
+ * string constants live in its own heap; strings a VM
+ * creates while running it are interned against them.
+ * Its global names are resolved to slots of whichever VM
+ * runs it.
+ */
+typedef struct {
+    Chunk chunk;
+    Heap heap;
+    Table globals; // global name -> slot
+} Program;
+
+Program *compile_program(const char *source, size_t length, FILE *errors);
+void free_program(Program *program);
+InterpretResult run_program(VM *vm, Program *program, Value *result);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef REGVM_H
+#define REGVM_H
+
+#include "chunk.h"
+#include "common.h"
+#include "vm.h"
+
+/* Register-based bytecode, produced by compile_registers().
+ * Every instruction is an opcode byte followed by 16-bit
+ * big-endian operands. A destination operand names a
+ * register. A source operand is an RK: a register, or a
+ * constant index when RK_CONSTANT is set. G is a global
+ * slot, shared with the stack VM's globals.
+ */
+typedef enum {
+    ROP_RETURN,         // RK
+    ROP_NEGATE,         // R, RK
+    ROP_NOT,            // R, RK
+    ROP_ADD,            // R, RK, RK
+    ROP_SUBTRACT,
+    ROP_MULTIPLY,
+    ROP_DIVIDE,
+    ROP_EQUAL,
+    ROP_NOT_EQUAL,
+    ROP_GREATER,
+    ROP_LESS,
+    ROP_GREATER_EQUAL,
+    ROP_LESS_EQUAL,
+    ROP_MOVE,           // R, RK
+    ROP_GET_GLOBAL,     // R, G
+    ROP_DEFINE_GLOBAL,  // G, RK
+    ROP_SET_GLOBAL,     // G, RK
+    ROP_COUNT // number of opcodes, not an instruction
+} RegOpCode;
+
+#define RK_CONSTANT 0x8000
+#define MAX_REGISTER_OPERAND 0x7FFF
+
+typedef struct {
+    Chunk chunk;        // register code, constants and lines
+    int register_count;
+} RegisterChunk;
+
+void init_register_chunk(RegisterChunk *chunk);
+void free_register_chunk(RegisterChunk *chunk);
+int register_instruction_length(uint8_t instruction);
+InterpretResult interpret_registers(VM *vm, const char *source, size_t length);
+InterpretResult run_register_chunk(VM *vm, RegisterChunk *chunk);
+
+// Implemented in debug.c.
+void disassemble_register_chunk(RegisterChunk *chunk, const char *name);
+int disassemble_register_instruction(RegisterChunk *chunk, int offset);
+
+#endif
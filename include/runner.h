@@ -0,0 +1,14 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include "vm.h"
+
+/* Runs one script on vm and returns its process exit
+ * status. Everything it prints must go to vm->out and
+ * vm->errors.
+ */
+typedef int (*ScriptRunner)(VM *vm, const char *path);
+
+int run_scripts(const char **paths, int count, int jobs, ScriptRunner run_script);
+
+#endif
@@ -4,6 +4,17 @@
 #include "common.h"
 #include <string.h>
 
+/* Width of the scanner's vector fast paths: AVX2 when the
+ * compiler targets it (e.g. DEFS=-mavx2), SSE2 on any
+ * x86-64, otherwise none. -DGRINO_SCALAR_SCANNER keeps only
+ * the scalar loops.
+ */
+#if !defined(GRINO_SCALAR_SCANNER) && defined(__AVX2__)
+#define SCANNER_AVX2
+#elif !defined(GRINO_SCALAR_SCANNER) && defined(__SSE2__)
+#define SCANNER_SSE2
+#endif
+
 typedef enum {
     // Single-character tokens.
     TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,
@@ -29,9 +40,13 @@ typedef enum {
     TOKEN_ERROR, TOKEN_EOF
 } TokenType;
 
+/* The source is a length-bounded buffer; it need not be
+ * NUL-terminated, so a mapped file can be scanned in place.
+ */
 typedef struct {
     const char *start;
     const char *current;
+    const char *end;
     int line;
 } Scanner;
 
@@ -42,7 +57,7 @@ typedef struct {
     int line;
 } Token;
 
-void init_scanner(const char *source);
-Token scan_token();
+void init_scanner(Scanner *scanner, const char *source, size_t length);
+Token scan_token(Scanner *scanner);
 
 #endif
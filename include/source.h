@@ -0,0 +1,22 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include "common.h"
+
+/* Script text handed to the compiler. Regular files are
+ * mapped read-only and scanned in place; stdin, pipes and
+ * other streams are read into a growing buffer instead.
+ * The text is not NUL-terminated.
+ */
+typedef struct {
+    const char *text;
+    size_t length;
+    void *mapping; // NULL when text lives in buffer
+    char *buffer;
+} Source;
+
+bool open_source(Source *source, const char *path);
+bool read_source_stream(Source *source, FILE *stream);
+void close_source(Source *source);
+
+#endif
@@ -17,6 +17,7 @@ typedef struct Stack {
 
 void init_stack(Stack* stack);
 void free_stack(Stack* stack);
+void reserve_stack(Stack* stack, int slots);
 void push(Stack* stack, Value value);
 Value pop(Stack* stack);
 Value peek(Stack *stack, int depth);
@@ -0,0 +1,37 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "common.h"
+#include "value.h"
+
+#define TABLE_MAX_LOAD 0.75
+#define INITIAL_TABLE_SIZE 8
+#define TABLE_GROWTH_FACTOR 2
+
+typedef struct {
+    ObjString *key; // NULL for an empty slot or a tombstone
+    Value value; // true in a tombstone
+} Entry;
+
+/* Hash table keyed by interned strings, with open addressing
+ * and linear probing. Keys are compared by pointer, so only
+ * lookups by content go through table_find_string(). A
+ * deleted entry leaves a tombstone so probes carry on past
+ * it; tombstones count towards the load until the table is
+ * resized.
+ */
+typedef struct {
+    int count; // entries and tombstones
+    int capacity; // a power of two
+    Entry *entries;
+} Table;
+
+void init_table(Table *table);
+void free_table(Table *table);
+bool table_get(Table *table, ObjString *key, Value *value);
+bool table_set(Table *table, ObjString *key, Value value);
+bool table_delete(Table *table, ObjString *key);
+ObjString *table_find_string(const Table *table, const char *chars, size_t length, uint32_t hash);
+ObjString *table_find_concatenation(const Table *table, ObjString *a, ObjString *b, uint32_t hash);
+
+#endif
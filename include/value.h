@@ -1,43 +1,175 @@
 #ifndef VALUE_H
 #define VALUE_H
 
+#include "arena.h"
 #include "common.h"
 #include "memory.h"
 
 #define MAX_REPRESENTABLE_CONST 0xFFFF // 16-bits
 
+typedef struct Obj Obj;
+typedef struct ObjString ObjString;
+
 typedef enum {
     VAL_BOOL,
     VAL_NULL,
     VAL_NUMBER,
+    VAL_INT,
+    VAL_OBJ,
+    VAL_UNDEFINED, // a global slot no var has defined yet
 } ValueType;
 
+#ifdef NAN_BOXING
+
+/* NaN-boxed representation (build with -DNAN_BOXING).
+ * A Value is a single 64-bit word. Any double that is not
+ * a quiet NaN with the QNAN bits set is stored as-is; the
+ * remaining singletons live in the low bits of that NaN
+ * space. The sign bit is left free for object pointers.
+ */
+#include <string.h>
+
+typedef uint64_t Value;
+
+#define SIGN_BIT    ((uint64_t)0x8000000000000000)
+#define QNAN        ((uint64_t)0x7ffc000000000000)
+
+#define TAG_NULL    1 // 01
+#define TAG_FALSE   2 // 10
+#define TAG_TRUE    3 // 11
+#define TAG_UNDEFINED 4 // 100
+
+/* Integers keep a 48-bit payload under their own tag bit;
+ * results outside that range become doubles, which print
+ * the same while they stay exact (see print_value()).
+ */
+#define TAG_INT     ((uint64_t)0x0002000000000000)
+#define INT_PAYLOAD ((uint64_t)0x0000ffffffffffff)
+#define INT_BITS    48
+
+#define IS_BOOL(value)      (((value) | 1) == TRUE_VAL)
+#define IS_NULL(value)      ((value) == NULL_VAL)
+#define IS_UNDEFINED(value) ((value) == UNDEFINED_VAL)
+#define IS_DOUBLE(value)    (((value) & QNAN) != QNAN)
+#define IS_INT(value)       (((value) & (SIGN_BIT | QNAN | TAG_INT)) == (QNAN | TAG_INT))
+#define IS_OBJ(value)       (((value) & (SIGN_BIT | QNAN)) == (SIGN_BIT | QNAN))
+#define AS_BOOL(value)      ((value) == TRUE_VAL)
+#define AS_DOUBLE(value)    value_to_num(value)
+#define AS_INT(value)       ((int64_t)((value) << (64 - INT_BITS)) >> (64 - INT_BITS))
+#define AS_OBJ(value)       ((Obj*)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+#define BOOL_VAL(value)     ((value) ? TRUE_VAL : FALSE_VAL)
+#define FALSE_VAL           ((Value)(uint64_t)(QNAN | TAG_FALSE))
+#define TRUE_VAL            ((Value)(uint64_t)(QNAN | TAG_TRUE))
+#define NULL_VAL            ((Value)(uint64_t)(QNAN | TAG_NULL))
+#define UNDEFINED_VAL       ((Value)(uint64_t)(QNAN | TAG_UNDEFINED))
+#define NUMBER_VAL(value)   num_to_value(value)
+#define INT_VAL(value)      ((Value)(QNAN | TAG_INT | ((uint64_t)(value) & INT_PAYLOAD)))
+#define OBJ_VAL(object)     ((Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(object)))
+#define INT_FITS(value)     ((value) >= -((int64_t)1 << (INT_BITS - 1)) && \
+                             (value) < ((int64_t)1 << (INT_BITS - 1)))
+
+static inline double value_to_num(Value value) {
+    double num;
+    memcpy(&num, &value, sizeof(Value));
+    return num;
+}
+
+static inline Value num_to_value(double num) {
+    Value value;
+    memcpy(&value, &num, sizeof(double));
+    return value;
+}
+
+#else
+
 typedef struct {
     ValueType type;
     union {
         bool boolean;
         double number;
+        int64_t integer;
+        Obj *obj;
     } as;
 } Value;
 
 #define IS_BOOL(value)      ((value).type == VAL_BOOL)
 #define IS_NULL(value)      ((value).type == VAL_NULL)
-#define IS_NUMBER(value)    ((value).type == VAL_NUMBER)
+#define IS_UNDEFINED(value) ((value).type == VAL_UNDEFINED)
+#define IS_DOUBLE(value)    ((value).type == VAL_NUMBER)
+#define IS_INT(value)       ((value).type == VAL_INT)
+#define IS_OBJ(value)       ((value).type == VAL_OBJ)
 #define AS_BOOL(value)      ((value).as.boolean)
-#define AS_NUMBER(value)    ((value).as.number)
+#define AS_DOUBLE(value)    ((value).as.number)
+#define AS_INT(value)       ((value).as.integer)
+#define AS_OBJ(value)       ((value).as.obj)
 #define BOOL_VAL(value)     ((Value){VAL_BOOL, {.boolean = value}})
 #define NULL_VAL            ((Value){VAL_NULL, {.number = 0}})
+#define UNDEFINED_VAL       ((Value){VAL_UNDEFINED, {.number = 0}})
 #define NUMBER_VAL(value)   ((Value){VAL_NUMBER, {.number = value}})
+#define INT_VAL(value)      ((Value){VAL_INT, {.integer = value}})
+#define OBJ_VAL(object)     ((Value){VAL_OBJ, {.obj = (Obj*)(object)}})
+#define INT_FITS(value)     true
+
+#endif
+
+/* A number is either an int or a double. AS_NUMBER() reads
+ * both as a double.
+ */
+#define IS_NUMBER(value)    (IS_INT(value) || IS_DOUBLE(value))
+#define AS_NUMBER(value)    value_as_double(value)
+
+static inline double value_as_double(Value value) {
+    return IS_INT(value) ? (double)AS_INT(value) : AS_DOUBLE(value);
+}
 
 typedef struct {
     int capacity;
     int count;
     Value *values;
+    Arena *arena; // NULL allocates through reallocate()
 } ValueArray;
 
 void init_value_array(ValueArray *array);
 void write_value_array(ValueArray *array, Value value);
 void free_value_array(ValueArray *array);
-void print_value(Value value);
+void print_value(FILE *out, Value value);
+bool values_equal(Value a, Value b);
+bool values_identical(Value a, Value b);
+uint32_t hash_value(Value value);
+
+static inline bool is_falsey(Value value) {
+    return IS_NULL(value) || 
+        (IS_BOOL(value) && !AS_BOOL(value)) ||
+        (IS_NUMBER(value) && AS_NUMBER(value) == 0);
+}
+
+/* Integer arithmetic for the VM and the constant folder.
+ * Each returns false when the result is not an int Value,
+ * overflowing, (for division) inexact, or a zero that
+ * doubles would give as -0, so the caller computes it with
+ * doubles instead. -0 and 1/-0 then keep their sign.
+ */
+static inline bool int_add(int64_t a, int64_t b, int64_t *result) {
+    return !__builtin_add_overflow(a, b, result) && INT_FITS(*result);
+}
+
+static inline bool int_subtract(int64_t a, int64_t b, int64_t *result) {
+    return !__builtin_sub_overflow(a, b, result) && INT_FITS(*result);
+}
+
+static inline bool int_multiply(int64_t a, int64_t b, int64_t *result) {
+    return !__builtin_mul_overflow(a, b, result) && INT_FITS(*result) &&
+        (*result != 0 || (a >= 0 && b >= 0));
+}
+
+static inline bool int_divide(int64_t a, int64_t b, int64_t *result) {
+    if(b == 0 || (b == -1 && a == INT64_MIN) || a % b != 0 || (a == 0 && b < 0)) return false;
+    *result = a / b;
+    return INT_FITS(*result);
+}
+
+static inline bool int_negate(int64_t a, int64_t *result) {
+    return a != 0 && int_subtract(0, a, result);
+}
 
 #endif
@@ -4,7 +4,13 @@
 #include "chunk.h"
 #include "common.h"
 #include "debug.h"
+#include "object.h"
+#include "profile.h"
 #include "stack.h"
+#include "table.h"
+
+#define INITIAL_GLOBALS_SIZE 8
+#define GLOBALS_GROWTH_FACTOR 2
 
 
 
@@ -14,13 +20,32 @@ typedef enum {
     INTERPRET_RUNTIME_ERROR
 } InterpretResult;
 
+/* One interpreter. Nothing in the VM is shared, so each
+ * thread may run its own.
+ */
 typedef struct {
     Chunk *chunk;
     uint8_t *ip;
     Stack stack;
+    Arena arena; // owns the chunk of each interpret() call
+    Heap heap; // strings created by compiling and running
+    Value *globals; // by slot, UNDEFINED_VAL until a var defines it
+    int global_capacity;
+    Table global_names; // name -> slot, kept across interpret() calls
+    const Table *running_names; // names of the globals of the running code
+    Profile *profile; // opcode counters, NULL when not profiling
+    FILE *out; // results, stdout by default
+    FILE *errors; // compile and runtime errors, stderr by default
 } VM;
 
-void init_vm();
-void free_vm();
-InterpretResult interpret(const char* source);
+void init_vm(VM *vm);
+void free_vm(VM *vm);
+InterpretResult interpret(VM *vm, const char* source, size_t length);
+InterpretResult interpret_chunk(VM *vm, Chunk *chunk);
+InterpretResult run_chunk(VM *vm, Chunk *chunk, Value *result);
+void print_vm_arena_report(VM *vm, FILE *out);
+void set_vm_profile(VM *vm, Profile *profile);
+void reset_globals(VM *vm);
+void reserve_globals(VM *vm, int count);
+ObjString *global_name(VM *vm, int slot);
 #endif
\ No newline at end of file
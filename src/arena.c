@@ -0,0 +1,114 @@
+#include <string.h>
+#include "arena.h"
+
+#define ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define BLOCK_HEADER ALIGN(sizeof(ArenaBlock))
+#define BLOCK_DATA(block) ((char *)(block) + BLOCK_HEADER)
+
+void init_arena(Arena *arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->in_use = 0;
+    arena->high_water = 0;
+    arena->reserved = 0;
+    arena->blocks = 0;
+    arena->resets = 0;
+}
+
+
+/* Releases every allocation in one step but keeps the
+ * blocks for the next compilation.
+ */
+void reset_arena(Arena *arena) {
+    for(ArenaBlock *block = arena->first; block != NULL; block = block->next) {
+        block->used = 0;
+    }
+    arena->current = arena->first;
+    arena->in_use = 0;
+    arena->resets += 1;
+}
+
+
+void free_arena(Arena *arena) {
+    ArenaBlock *block = arena->first;
+    while(block != NULL) {
+        ArenaBlock *next = block->next;
+        reallocate(block, BLOCK_HEADER + block->capacity, 0);
+        block = next;
+    }
+    init_arena(arena);
+}
+
+
+static void *bump(Arena *arena, size_t size) {
+    ArenaBlock *block = arena->current;
+    // Blocks after current are empty, so skip forward to one that fits.
+    while(block != NULL && block->used + size > block->capacity) {
+        if(block->next == NULL) break;
+        block = block->next;
+    }
+
+    if(block == NULL || block->used + size > block->capacity) {
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock *fresh = reallocate(NULL, 0, BLOCK_HEADER + capacity);
+        if(fresh == NULL) exit(1);
+        fresh->capacity = capacity;
+        fresh->used = 0;
+        fresh->next = NULL;
+        if(block == NULL) {
+            arena->first = fresh;
+        } else {
+            block->next = fresh;
+        }
+        arena->reserved += capacity;
+        arena->blocks += 1;
+        block = fresh;
+    }
+
+    arena->current = block;
+    void *result = BLOCK_DATA(block) + block->used;
+    block->used += size;
+    return result;
+}
+
+
+static bool is_last_allocation(Arena *arena, void *pointer, size_t size) {
+    ArenaBlock *block = arena->current;
+    return block != NULL && (char *)pointer + size == BLOCK_DATA(block) + block->used;
+}
+
+
+/* Same contract as reallocate(). With a NULL arena it is
+ * reallocate(); otherwise the most recent allocation grows
+ * or shrinks in place, and anything else is copied to a
+ * fresh bump allocation. Freed memory other than the most
+ * recent allocation is only reclaimed by reset_arena().
+ */
+void *arena_reallocate(Arena *arena, void *pointer, size_t old_size, size_t new_size) {
+    if(arena == NULL) return reallocate(pointer, old_size, new_size);
+
+    size_t old_aligned = pointer == NULL ? 0 : ALIGN(old_size);
+    size_t new_aligned = ALIGN(new_size);
+
+    if(pointer != NULL && is_last_allocation(arena, pointer, old_aligned) &&
+        arena->current->used - old_aligned + new_aligned <= arena->current->capacity) {
+        arena->current->used = arena->current->used - old_aligned + new_aligned;
+        arena->in_use = arena->in_use - old_aligned + new_aligned;
+    } else if(new_size == 0) {
+        return NULL;
+    } else {
+        void *result = bump(arena, new_aligned);
+        if(pointer != NULL) memcpy(result, pointer, old_size < new_size ? old_size : new_size);
+        arena->in_use += new_aligned;
+        pointer = result;
+    }
+
+    if(arena->in_use > arena->high_water) arena->high_water = arena->in_use;
+    return new_size == 0 ? NULL : pointer;
+}
+
+
+void print_arena_report(Arena *arena, const char *name, FILE *out) {
+    fprintf(out, "arena %s: high-water %zu bytes, %zu bytes reserved in %d block(s), %d reset(s)\n",
+        name, arena->high_water, arena->reserved, arena->blocks, arena->resets);
+}
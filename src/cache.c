@@ -0,0 +1,517 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+#include "compiler.h"
+#include "debug.h"
+#include "object.h"
+#include "stack.h"
+
+#define CACHE_BYTE_ORDER 0x01020304
+#define CONSTANT_RECORD_SIZE 9 // tag byte, then 8 payload bytes
+#define GLOBAL_RECORD_SIZE 8 // offset and length of the name in the string section
+
+typedef enum {
+    CONSTANT_NULL,
+    CONSTANT_FALSE,
+    CONSTANT_TRUE,
+    CONSTANT_NUMBER,
+    CONSTANT_INT,
+    CONSTANT_STRING, // offset and length in the string section
+} ConstantTag;
+
+/* On-disk layout, all in native byte order:
+ *
+ *   header | line table | constant records | global records |
+ *   strings | pad | code
+ *
+ * Global records hold the names of the global slots in slot
+ * order. The strings of the constants come first in the
+ * string section, then those of the names.
+ *
+ * The code section starts on a CACHE_ALIGNMENT boundary so
+ * the file can be mapped and executed in place.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t opcode_count;
+    uint64_t source_hash;
+    uint64_t source_length;
+    uint32_t line_count;
+    uint32_t constant_count;
+    uint32_t global_count;
+    uint32_t code_length;
+    uint32_t max_stack;
+    uint32_t lines_offset;
+    uint32_t constants_offset;
+    uint32_t globals_offset;
+    uint32_t strings_offset;
+    uint32_t strings_length;
+    uint32_t code_offset;
+    uint32_t instruction_set; // SUPERINSTRUCTION_SET of the writer
+} CacheHeader;
+
+static const char cache_magic[4] = {'G', 'R', 'N', 'C'};
+
+/* Values each base opcode pops and then pushes. OP_POPN pops
+ * its operand instead.
+ */
+typedef struct {
+    uint8_t pops;
+    uint8_t pushes;
+} StackUse;
+
+static const StackUse stack_uses[] = {
+    [OP_RETURN]         = {1, 0},
+    [OP_CONSTANT]       = {0, 1},
+    [OP_CONSTANT_LONG]  = {0, 1},
+    [OP_NEGATE]         = {1, 1},
+    [OP_ADD]            = {2, 1},
+    [OP_SUBTRACT]       = {2, 1},
+    [OP_MULTIPLY]       = {2, 1},
+    [OP_DIVIDE]         = {2, 1},
+    [OP_NULL]           = {0, 1},
+    [OP_TRUE]           = {0, 1},
+    [OP_FALSE]          = {0, 1},
+    [OP_NOT]            = {1, 1},
+    [OP_EQUAL]          = {2, 1},
+    [OP_GREATER]        = {2, 1},
+    [OP_LESS]           = {2, 1},
+    [OP_GREATER_EQUAL]  = {2, 1},
+    [OP_LESS_EQUAL]     = {2, 1},
+    [OP_NOT_EQUAL]      = {2, 1},
+    [OP_POP]            = {1, 0},
+    [OP_DEFINE_GLOBAL]  = {1, 0},
+    [OP_GET_GLOBAL]     = {0, 1},
+    [OP_SET_GLOBAL]     = {1, 1},
+    [OP_GET_LOCAL]      = {0, 1},
+    [OP_SET_LOCAL]      = {1, 1},
+    [OP_POPN]           = {0, 0},
+};
+
+/* The two base opcodes a superinstruction runs. A base
+ * opcode is its own first half, with OP_COUNT for the second.
+ */
+static const uint8_t instruction_halves[][2] = {
+#define OPCODE(name, operand) [name] = {name, OP_COUNT},
+#include "opcodes.def"
+#undef OPCODE
+#define SUPERINSTRUCTION(name, first, second, operand) [name] = {first, second},
+#include "superinstructions.h"
+#undef SUPERINSTRUCTION
+};
+
+
+/* 64-bit FNV-1a. */
+uint64_t hash_source(const char *source, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)source[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+static size_t align_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+
+/* Strings are written to the string section in constant
+ * order; string_offset is where the next one starts.
+ */
+static void encode_constant(uint8_t *record, Value value, uint32_t *string_offset) {
+    double number = 0;
+    if(IS_STRING(value)) {
+        record[0] = CONSTANT_STRING;
+        uint32_t location[2] = { *string_offset, AS_STRING(value)->length };
+        memcpy(record + 1, location, sizeof(location));
+        *string_offset += location[1];
+        return;
+    } else if(IS_NULL(value)) {
+        record[0] = CONSTANT_NULL;
+    } else if(IS_BOOL(value)) {
+        record[0] = AS_BOOL(value) ? CONSTANT_TRUE : CONSTANT_FALSE;
+    } else if(IS_INT(value)) {
+        record[0] = CONSTANT_INT;
+        int64_t integer = AS_INT(value);
+        memcpy(record + 1, &integer, sizeof(integer));
+        return;
+    } else {
+        record[0] = CONSTANT_NUMBER;
+        number = AS_DOUBLE(value);
+    }
+    memcpy(record + 1, &number, sizeof(number));
+}
+
+
+static bool decode_string(const uint32_t location[2], const char *strings,
+    uint32_t strings_length, Heap *heap, ObjString **string) {
+    if(location[0] > strings_length || location[1] > strings_length - location[0]) {
+        return false;
+    }
+    *string = copy_string(heap, strings + location[0], location[1]);
+    return true;
+}
+
+
+static bool decode_constant(const uint8_t *record, const char *strings,
+    uint32_t strings_length, Heap *heap, Value *value) {
+    double number;
+    int64_t integer;
+    uint32_t location[2];
+    ObjString *string;
+    memcpy(&number, record + 1, sizeof(number));
+    memcpy(&integer, record + 1, sizeof(integer));
+    memcpy(location, record + 1, sizeof(location));
+    switch(record[0]) {
+        case CONSTANT_NULL: *value = NULL_VAL; return true;
+        case CONSTANT_FALSE: *value = BOOL_VAL(false); return true;
+        case CONSTANT_TRUE: *value = BOOL_VAL(true); return true;
+        case CONSTANT_NUMBER: *value = NUMBER_VAL(number); return true;
+        case CONSTANT_INT:
+            // Written by a build whose ints are wider than ours.
+            if(!INT_FITS(integer)) return false;
+            *value = INT_VAL(integer);
+            return true;
+        case CONSTANT_STRING:
+            if(!decode_string(location, strings, strings_length, heap, &string)) return false;
+            *value = OBJ_VAL(string);
+            return true;
+        default: return false;
+    }
+}
+
+
+/* Applies one base opcode to the stack height the code has
+ * reached, with operand as read for the instruction. Returns
+ * false for an instruction that would read below the stack,
+ * a local slot not on it, or an OP_RETURN that would not
+ * leave exactly the script's value.
+ */
+static bool run_stack_use(uint8_t op, uint8_t operand, uint32_t *height) {
+    StackUse use = stack_uses[op];
+    if(op == OP_POPN) use.pops = operand;
+    if(use.pops > *height) return false;
+    if((op == OP_GET_LOCAL || op == OP_SET_LOCAL) && operand >= *height) return false;
+    if(op == OP_RETURN && *height != 1) return false;
+    *height = *height - use.pops + use.pushes;
+    return true;
+}
+
+
+/* The VM trusts its bytecode, so every instruction is checked
+ * once here: known opcodes, operands inside the code, constant
+ * indices inside the pool, global slots the file names, and
+ * the stack height each instruction leaves, which must stay
+ * within the header's max_stack and end in an OP_RETURN of
+ * exactly one value. The code has no jumps, so one pass in
+ * order sees every height the VM can reach.
+ */
+static bool validate_code(const uint8_t *code, uint32_t length, uint32_t constant_count,
+    uint32_t global_count, uint32_t max_stack) {
+    uint32_t offset = 0;
+    uint32_t height = 0;
+    uint8_t last = OP_COUNT;
+    while(offset < length) {
+        last = code[offset];
+        if(last >= OP_COUNT) return false;
+        uint32_t next = offset + instruction_length(last);
+        if(next > length) return false;
+        switch(opcode_operand(last)) {
+            case OPERAND_CONSTANT:
+                if(code[offset + 1] >= constant_count) return false;
+                break;
+            case OPERAND_CONSTANT_LONG:
+                if(((code[offset + 1] << 8) | code[offset + 2]) >= constant_count) return false;
+                break;
+            case OPERAND_GLOBAL:
+                if(((code[offset + 1] << 8) | code[offset + 2]) >= global_count) return false;
+                break;
+            default:
+                break;
+        }
+
+        // Only the first half of a superinstruction has an operand.
+        uint8_t operand = next - offset == 2 ? code[offset + 1] : 0;
+        const uint8_t *halves = instruction_halves[last];
+        if(!run_stack_use(halves[0], operand, &height) || height > max_stack) return false;
+        if(halves[1] != OP_COUNT &&
+            (!run_stack_use(halves[1], 0, &height) || height > max_stack)) return false;
+        offset = next;
+    }
+    return last == OP_RETURN;
+}
+
+
+static bool valid_header(const CacheHeader *header, size_t file_size,
+    const char *source, size_t length) {
+    if(memcmp(header->magic, cache_magic, sizeof(cache_magic)) != 0 ||
+        header->version != CACHE_VERSION ||
+        header->byte_order != CACHE_BYTE_ORDER ||
+        header->opcode_count != OP_COUNT ||
+        header->instruction_set != SUPERINSTRUCTION_SET ||
+        header->source_length != length ||
+        header->constant_count > MAX_REPRESENTABLE_CONST + 1 ||
+        header->global_count > UINT16_MAX + 1 ||
+        header->max_stack > STACK_MAX) return false;
+
+    // Sections must lie inside the file in layout order.
+    uint64_t lines_end = (uint64_t)header->lines_offset +
+        (uint64_t)header->line_count * sizeof(LineStart);
+    uint64_t constants_end = (uint64_t)header->constants_offset +
+        (uint64_t)header->constant_count * CONSTANT_RECORD_SIZE;
+    uint64_t globals_end = (uint64_t)header->globals_offset +
+        (uint64_t)header->global_count * GLOBAL_RECORD_SIZE;
+    uint64_t strings_end = (uint64_t)header->strings_offset + header->strings_length;
+    uint64_t code_end = (uint64_t)header->code_offset + header->code_length;
+    if(header->lines_offset < sizeof(CacheHeader) ||
+        header->lines_offset % sizeof(int) != 0 ||
+        header->constants_offset < lines_end ||
+        header->globals_offset < constants_end ||
+        header->strings_offset < globals_end ||
+        header->code_offset < strings_end ||
+        header->code_offset % CACHE_ALIGNMENT != 0 ||
+        code_end > file_size) return false;
+
+    // Hash last; it is the only check that reads the whole source.
+    return header->source_hash == hash_source(source, length);
+}
+
+
+/* Maps cache_path and fills cached->chunk from it when the
+ * file was written for exactly this source. String constants
+ * are interned in heap, and globals, which must be empty, is
+ * given the slots the code was compiled with. Returns false
+ * for a missing, stale or damaged file.
+ */
+bool load_cached_chunk(CachedChunk *cached, Heap *heap, Table *globals,
+    const char *cache_path, const char *source, size_t length) {
+    if(globals->count != 0) return false;
+    int fd = open(cache_path, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t file_size = info.st_size;
+    uint8_t *base = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) return false;
+
+    CacheHeader header;
+    memcpy(&header, base, sizeof(header));
+    if(!valid_header(&header, file_size, source, length) ||
+        !validate_code(base + header.code_offset, header.code_length,
+            header.constant_count, header.global_count, header.max_stack)) {
+        munmap(base, file_size);
+        return false;
+    }
+
+    Chunk *chunk = &cached->chunk;
+    init_chunk(chunk);
+    free_chunk(chunk); // drop the initial buffers, keep the fields
+    chunk->borrowed = true;
+    chunk->code = base + header.code_offset;
+    chunk->count = chunk->capacity = header.code_length;
+    chunk->lines = (LineStart*)(base + header.lines_offset);
+    chunk->line_count = chunk->line_capacity = header.line_count;
+    chunk->max_stack = header.max_stack;
+    chunk->global_count = header.global_count;
+
+    const uint8_t *record = base + header.constants_offset;
+    const char *strings = (const char*)base + header.strings_offset;
+    for(uint32_t i = 0; i < header.constant_count; i++) {
+        Value value;
+        if(!decode_constant(record, strings, header.strings_length, heap, &value)) {
+            free_chunk(chunk);
+            munmap(base, file_size);
+            return false;
+        }
+        write_value_array(&chunk->constants, value);
+        record += CONSTANT_RECORD_SIZE;
+    }
+
+    record = base + header.globals_offset;
+    for(uint32_t i = 0; i < header.global_count; i++) {
+        uint32_t location[2];
+        ObjString *name;
+        memcpy(location, record, sizeof(location));
+        // A name twice would leave a slot without one.
+        if(!decode_string(location, strings, header.strings_length, heap, &name) ||
+            !table_set(globals, name, INT_VAL(i))) {
+            free_table(globals);
+            free_chunk(chunk);
+            munmap(base, file_size);
+            return false;
+        }
+        record += GLOBAL_RECORD_SIZE;
+    }
+
+    cached->mapping = base;
+    cached->mapping_size = file_size;
+    return true;
+}
+
+
+void free_cached_chunk(CachedChunk *cached) {
+    free_chunk(&cached->chunk);
+    munmap(cached->mapping, cached->mapping_size);
+    cached->mapping = NULL;
+    cached->mapping_size = 0;
+}
+
+
+static bool write_padding(FILE *file, size_t count) {
+    static const uint8_t zeros[64];
+    while(count > 0) {
+        size_t n = count < sizeof(zeros) ? count : sizeof(zeros);
+        if(fwrite(zeros, 1, n, file) != n) return false;
+        count -= n;
+    }
+    return true;
+}
+
+
+/* Lists the names of globals by slot. */
+static ObjString **global_names(const Table *globals) {
+    ObjString **names = reallocate(NULL, 0, globals->count * sizeof(ObjString*));
+    for(int i = 0; i < globals->capacity; i++) {
+        Entry *entry = &globals->entries[i];
+        if(entry->key != NULL) names[AS_INT(entry->value)] = entry->key;
+    }
+    return names;
+}
+
+
+static bool write_sections(FILE *file, const CacheHeader *header, Chunk *chunk,
+    ObjString **names) {
+    if(fwrite(header, sizeof(*header), 1, file) != 1) return false;
+    if(!write_padding(file, header->lines_offset - sizeof(*header))) return false;
+    if(fwrite(chunk->lines, sizeof(LineStart), chunk->line_count, file) !=
+        (size_t)chunk->line_count) return false;
+
+    uint32_t string_offset = 0;
+    for(int i = 0; i < chunk->constants.count; i++) {
+        uint8_t record[CONSTANT_RECORD_SIZE];
+        encode_constant(record, chunk->constants.values[i], &string_offset);
+        if(fwrite(record, sizeof(record), 1, file) != 1) return false;
+    }
+    for(uint32_t i = 0; i < header->global_count; i++) {
+        uint32_t location[2] = { string_offset, names[i]->length };
+        string_offset += names[i]->length;
+        if(fwrite(location, sizeof(location), 1, file) != 1) return false;
+    }
+
+    for(int i = 0; i < chunk->constants.count; i++) {
+        Value value = chunk->constants.values[i];
+        if(!IS_STRING(value)) continue;
+        ObjString *string = AS_STRING(value);
+        if(fwrite(string->chars, 1, string->length, file) != string->length) return false;
+    }
+    for(uint32_t i = 0; i < header->global_count; i++) {
+        if(fwrite(names[i]->chars, 1, names[i]->length, file) != names[i]->length) return false;
+    }
+
+    size_t strings_end = header->strings_offset + (size_t)header->strings_length;
+    if(!write_padding(file, header->code_offset - strings_end)) return false;
+    return fwrite(chunk->code, 1, chunk->count, file) == (size_t)chunk->count;
+}
+
+
+/* Writes chunk and the names of the global slots it was
+ * compiled with to a temporary file and renames it over
+ * cache_path, so readers never see a partial cache.
+ */
+bool write_cached_chunk(Chunk *chunk, const Table *globals, const char *cache_path,
+    const char *source, size_t length) {
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = CACHE_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.opcode_count = OP_COUNT;
+    header.instruction_set = SUPERINSTRUCTION_SET;
+    header.source_hash = hash_source(source, length);
+    header.source_length = length;
+    header.line_count = chunk->line_count;
+    header.constant_count = chunk->constants.count;
+    header.global_count = globals->count;
+    header.code_length = chunk->count;
+    header.max_stack = chunk->max_stack;
+    header.lines_offset = sizeof(header);
+    header.constants_offset = header.lines_offset + chunk->line_count * sizeof(LineStart);
+    header.globals_offset = header.constants_offset +
+        chunk->constants.count * CONSTANT_RECORD_SIZE;
+    header.strings_offset = header.globals_offset + globals->count * GLOBAL_RECORD_SIZE;
+    for(int i = 0; i < chunk->constants.count; i++) {
+        Value value = chunk->constants.values[i];
+        if(IS_STRING(value)) header.strings_length += AS_STRING(value)->length;
+    }
+    ObjString **names = global_names(globals);
+    for(int i = 0; i < globals->count; i++) header.strings_length += names[i]->length;
+    header.code_offset = align_up((size_t)header.strings_offset + header.strings_length,
+        CACHE_ALIGNMENT);
+
+    size_t path_size = strlen(cache_path) + 8;
+    char *temp_path = malloc(path_size);
+    if(temp_path == NULL) {
+        reallocate(names, globals->count * sizeof(ObjString*), 0);
+        return false;
+    }
+    snprintf(temp_path, path_size, "%s.XXXXXX", cache_path);
+
+    // mkstemp, not the pid: threads of one process may race here.
+    int fd = mkstemp(temp_path);
+    if(fd < 0) {
+        reallocate(names, globals->count * sizeof(ObjString*), 0);
+        free(temp_path);
+        return false;
+    }
+    fchmod(fd, 0644);
+    FILE *file = fdopen(fd, "wb");
+    if(file == NULL) close(fd);
+    bool written = file != NULL && write_sections(file, &header, chunk, names);
+    if(file != NULL && fclose(file) != 0) written = false;
+    if(written) written = rename(temp_path, cache_path) == 0;
+    if(!written) remove(temp_path);
+
+    reallocate(names, globals->count * sizeof(ObjString*), 0);
+    free(temp_path);
+    return written;
+}
+
+
+/* Runs source from the cache at cache_path when it matches,
+ * otherwise compiles it and refreshes the cache. A cache
+ * that cannot be written only costs the next run a compile.
+ */
+InterpretResult interpret_cached(VM *vm, const char *source, size_t length,
+    const char *cache_path) {
+    CachedChunk cached;
+    if(load_cached_chunk(&cached, &vm->heap, &vm->global_names, cache_path, source, length)) {
+        if(debug_options.print_code) disassemble_chunk(&cached.chunk, "code");
+        InterpretResult result = interpret_chunk(vm, &cached.chunk);
+        free_cached_chunk(&cached);
+        return result;
+    }
+
+    Chunk chunk;
+    init_chunk(&chunk);
+    InterpretResult result = INTERPRET_COMPILE_ERROR;
+    if(compile(source, length, &chunk, &vm->heap, &vm->global_names, vm->errors)) {
+        write_cached_chunk(&chunk, &vm->global_names, cache_path, source, length);
+        result = interpret_chunk(vm, &chunk);
+    }
+    free_chunk(&chunk);
+    return result;
+}
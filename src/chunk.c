@@ -1,7 +1,26 @@
 #include "chunk.h"
 
+/* A superinstruction takes the operand of its first half. */
+static const OperandKind operands[] = {
+#define OPCODE(name, operand) [name] = operand,
+#include "opcodes.def"
+#undef OPCODE
+#define SUPERINSTRUCTION(name, first, second, operand) [name] = operand,
+#include "superinstructions.h"
+#undef SUPERINSTRUCTION
+};
+
 
 void init_chunk(Chunk *chunk) {
+    init_chunk_in_arena(chunk, NULL);
+}
+
+
+/* All of the chunk's buffers come from the arena, so they
+ * are released together when the arena is reset.
+ */
+void init_chunk_in_arena(Chunk *chunk, Arena *arena) {
+    chunk->arena = arena;
     chunk->count = 0;
     chunk->capacity = INITIAL_CHUNK_SIZE;
     /* Reallocate used instead of malloc because:
@@ -10,58 +29,82 @@ void init_chunk(Chunk *chunk) {
            in order for garbage collector to
            have a count of memory in use.
     */
-    chunk->code = reallocate(NULL, 0, INITIAL_CHUNK_SIZE * sizeof(uint8_t));
-    chunk->lines = reallocate(NULL, 0, INITIAL_CHUNK_LINE_SIZE * sizeof(int));
-    chunk->lines[0] = -1;
-    chunk->lines[1] = -1;
-    chunk->line_count = 2;
+    chunk->code = arena_reallocate(arena, NULL, 0, INITIAL_CHUNK_SIZE * sizeof(uint8_t));
+    chunk->lines = arena_reallocate(arena, NULL, 0, INITIAL_CHUNK_LINE_SIZE * sizeof(LineStart));
+    chunk->line_count = 0;
     chunk->line_capacity = INITIAL_CHUNK_LINE_SIZE;
     init_value_array(&chunk->constants);
+    chunk->constants.arena = arena;
+    chunk->constant_slots = NULL;
+    chunk->constant_slot_capacity = 0;
+    chunk->max_stack = 0;
+    chunk->global_count = 0;
+    chunk->borrowed = false;
 }
 
 void free_chunk(Chunk *chunk) {
-    // Argument of old_size honestly doesn't matter...
-    chunk->code = reallocate(chunk->code, sizeof(uint8_t) * chunk->capacity, 0);
-    chunk->lines = reallocate(chunk->lines, sizeof(int) * chunk->line_capacity, 0);
+    // Borrowed code and lines are released with their mapping.
+    if(!chunk->borrowed) {
+        // Argument of old_size honestly doesn't matter...
+        chunk->code = arena_reallocate(chunk->arena, chunk->code, sizeof(uint8_t) * chunk->capacity, 0);
+        chunk->lines = arena_reallocate(chunk->arena, chunk->lines, sizeof(LineStart) * chunk->line_capacity, 0);
+    }
     free_value_array(&chunk->constants);
+    chunk->constant_slots = arena_reallocate(chunk->arena, chunk->constant_slots,
+        sizeof(int) * chunk->constant_slot_capacity, 0);
+    chunk->constant_slot_capacity = 0;
 }
 
 static void add_line(Chunk *chunk, int line) {
+    // Bytes from the same line extend the current run.
+    if (chunk->line_count > 0 &&
+        chunk->lines[chunk->line_count - 1].line == line) return;
+
     // Check if there is enough space for new element
     if (chunk->line_capacity < chunk->line_count + 1) {
-        // Check if chunk data is NULL
         chunk->line_capacity = chunk->line_capacity * CHUNK_GROWTH_FACTOR;
         
-        chunk->lines = reallocate(chunk->lines, chunk->line_count * sizeof(int),
-            chunk->line_capacity * sizeof(int));
+        chunk->lines = arena_reallocate(chunk->arena, chunk->lines, chunk->line_count * sizeof(LineStart),
+            chunk->line_capacity * sizeof(LineStart));
     }
-    // Check if previous line is the same as new line
-    int curr_line_run_el = chunk->lines[chunk->line_count - 1];
-    
-    if (curr_line_run_el != line) {
-        chunk->lines[chunk->line_count] = 1;
-        chunk->lines[chunk->line_count + 1] = line;
-        chunk->line_count += 2;
-    } else {
-        chunk->lines[chunk->line_count - 2] += 1;
+
+    chunk->lines[chunk->line_count].offset = chunk->count;
+    chunk->lines[chunk->line_count].line = line;
+    chunk->line_count += 1;
+}
+
+
+int get_line(Chunk *chunk, int offset) {
+    // Find the last run starting at or before offset.
+    int low = 0;
+    int high = chunk->line_count - 1;
+    while(low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if(chunk->lines[mid].offset <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
     }
+    return chunk->line_count > 0 ? chunk->lines[low].line : -1;
+}
 
 
+void init_line_cursor(LineCursor *cursor, Chunk *chunk) {
+    cursor->chunk = chunk;
+    cursor->index = 0;
 }
 
 
-int get_line(Chunk *chunk, int offset) {
-    int index = 2;
-
-    // Given offset, eat through chunk lines until offset == 0
-    while(offset > 0) {
-        offset -= chunk->lines[index];
-        //printf("OFFSET: %d\n", offset);
-        if(offset < 0) return chunk->lines[index + 1];
-        index += 2;
-        if(offset == 0) return chunk->lines[index + 1];
+/* Offsets passed to a cursor must never decrease. */
+int cursor_line(LineCursor *cursor, int offset) {
+    Chunk *chunk = cursor->chunk;
+    if(chunk->line_count == 0) return -1;
+    while(cursor->index + 1 < chunk->line_count &&
+        chunk->lines[cursor->index + 1].offset <= offset) {
+        cursor->index += 1;
     }
-    return chunk->lines[index + 1];
+    return chunk->lines[cursor->index].line;
 }
 
 
@@ -70,7 +113,7 @@ void write_chunk(Chunk *chunk, uint8_t byte, int line) {
         // Check if chunk data is NULL
         chunk->capacity = chunk->capacity * CHUNK_GROWTH_FACTOR;
         
-        chunk->code = reallocate(chunk->code, chunk->count * sizeof(uint8_t),
+        chunk->code = arena_reallocate(chunk->arena, chunk->code, chunk->count * sizeof(uint8_t),
             chunk->capacity * sizeof(uint8_t));
     }
 
@@ -79,9 +122,51 @@ void write_chunk(Chunk *chunk, uint8_t byte, int line) {
     chunk->count += 1;
 }
 
+static int *find_constant_slot(int *slots, int capacity, ValueArray *constants, Value value) {
+    // Capacity is a power of two, so masking wraps the probe.
+    uint32_t index = hash_value(value) & (capacity - 1);
+    for(;;) {
+        int *slot = &slots[index];
+        if(*slot == -1 || values_identical(constants->values[*slot], value)) {
+            return slot;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+
+static void grow_constant_slots(Chunk *chunk) {
+    int capacity = chunk->constant_slot_capacity < INITIAL_CHUNK_SIZE ?
+        INITIAL_CHUNK_SIZE : chunk->constant_slot_capacity * CHUNK_GROWTH_FACTOR;
+    int *slots = arena_reallocate(chunk->arena, NULL, 0, capacity * sizeof(int));
+    for(int i = 0; i < capacity; i++) slots[i] = -1;
+
+    // Re-insert every constant; they are all distinct already.
+    for(int i = 0; i < chunk->constants.count; i++) {
+        *find_constant_slot(slots, capacity, &chunk->constants,
+            chunk->constants.values[i]) = i;
+    }
+
+    arena_reallocate(chunk->arena, chunk->constant_slots,
+        chunk->constant_slot_capacity * sizeof(int), 0);
+    chunk->constant_slots = slots;
+    chunk->constant_slot_capacity = capacity;
+}
+
+
 size_t add_constant(Chunk *chunk, Value value) {
+    // Keep the index at most 3/4 full.
+    if((chunk->constants.count + 1) * 4 > chunk->constant_slot_capacity * 3) {
+        grow_constant_slots(chunk);
+    }
+
+    int *slot = find_constant_slot(chunk->constant_slots,
+        chunk->constant_slot_capacity, &chunk->constants, value);
+    if(*slot != -1) return *slot; // value is already in the pool
+
     write_value_array(&chunk->constants, value);
-    return chunk->constants.count - 1; // index of constant in values
+    *slot = chunk->constants.count - 1;
+    return *slot; // index of constant in values
 }
 
 void write_constant(Chunk *chunk, Value value, int line) {
@@ -97,4 +182,22 @@ void write_constant(Chunk *chunk, Value value, int line) {
         write_chunk(chunk, OP_CONSTANT, line);
     }
     write_chunk(chunk, index & 0x00FF, line);
-}
\ No newline at end of file
+}
+
+
+OperandKind opcode_operand(uint8_t opcode) {
+    return opcode < OP_COUNT ? operands[opcode] : OPERAND_NONE;
+}
+
+
+/* Bytes taken by an instruction, its operand included. */
+int instruction_length(uint8_t opcode) {
+    switch(opcode_operand(opcode)) {
+        case OPERAND_CONSTANT:
+        case OPERAND_LOCAL:
+        case OPERAND_COUNT:         return 2;
+        case OPERAND_CONSTANT_LONG:
+        case OPERAND_GLOBAL:        return 3;
+        default:                    return 1;
+    }
+}
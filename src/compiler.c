@@ -1,33 +1,97 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "compiler.h"
 #include "value.h"
-
-#ifdef DEBUG_PRINT_CODE
 #include "debug.h"
-#endif
-
-static Parser parser;
-
-static void advance();
-static void expression();
-static void error_at_current(const char* message);
-static void error(const char* message);
-static void error_at(Token* token, const char* message);
-static void consume(TokenType token, const char* message);
-static void end_compiler();
-static void emit_byte(uint8_t byte);
-static Chunk* current_chunk();
-static void emit_return();
-static void emit_constant(Value value);
-static uint16_t make_constant(Value value);
-static void number();
-static void grouping();
-static void binary();
-static void unary();
+#include "number.h"
+#include "object.h"
+
+static bool compile_chunk(const char* source, size_t length, Chunk* chunk, Heap* heap,
+    Table* globals, FILE* errors, bool superinstructions);
+static void advance(Parser* parser);
+static bool check(Parser* parser, TokenType type);
+static bool match(Parser* parser, TokenType type);
+static bool declaration(Parser* parser);
+static void var_declaration(Parser* parser);
+static bool statement(Parser* parser);
+static bool expression_statement(Parser* parser);
+static void block(Parser* parser);
+static void begin_scope(Parser* parser);
+static void end_scope(Parser* parser);
+static void synchronize(Parser* parser);
+static void expression(Parser* parser);
+static void error_at_current(Parser* parser, const char* message);
+static void error(Parser* parser, const char* message);
+static void error_at(Parser* parser, Token* token, const char* message);
+static void consume(Parser* parser, TokenType token, const char* message);
+static void end_compiler(Parser* parser);
+static void emit_byte(Parser* parser, uint8_t byte);
+static void emit_op(Parser* parser, OpCode op);
+static void emit_global_op(Parser* parser, OpCode op, uint16_t slot);
+static void emit_byte_op(Parser* parser, OpCode op, uint8_t operand);
+static void adjust_stack(Parser* parser, int effect);
+static Chunk* current_chunk(Parser* parser);
+static void emit_return(Parser* parser);
+static void emit_constant(Parser* parser, Value value);
+static void flush_constants(Parser* parser);
+static void write_constant_load(Parser* parser, Value value, int line);
+static uint16_t make_constant(Parser* parser, Value value);
+static PendingConstant* folding_operand(Parser* parser, int pending_count, int code_count);
+static bool fold_binary(Parser* parser, TokenType operator_type, int pending_count, int code_count);
+static bool fold_integers(TokenType operator_type, int64_t x, int64_t y, Value* result);
+static void number(Parser* parser, bool can_assign);
+static void string(Parser* parser, bool can_assign);
+static void grouping(Parser* parser, bool can_assign);
+static void binary(Parser* parser, bool can_assign);
+static void unary(Parser* parser, bool can_assign);
 static ParseRule* get_rule(TokenType type);
-static void parse_precedence(Precedence precedence);
-static void literal();
+static void parse_precedence(Parser* parser, Precedence precedence);
+static void literal(Parser* parser, bool can_assign);
+static void variable(Parser* parser, bool can_assign);
+static uint16_t global_slot(Parser* parser, Token* name);
+static int declare_local(Parser* parser, Token* name);
+static int resolve_local(Parser* parser, Token* name);
+
+/* Net change in stack height caused by each opcode, used
+ * to record the chunk's maximum stack depth.
+ */
+static const int stack_effects[] = {
+    [OP_RETURN]         = -1,
+    [OP_CONSTANT]       = 1,
+    [OP_CONSTANT_LONG]  = 1,
+    [OP_NEGATE]         = 0,
+    [OP_ADD]            = -1,
+    [OP_SUBTRACT]       = -1,
+    [OP_MULTIPLY]       = -1,
+    [OP_DIVIDE]         = -1,
+    [OP_NULL]           = 1,
+    [OP_TRUE]           = 1,
+    [OP_FALSE]          = 1,
+    [OP_NOT]            = 0,
+    [OP_EQUAL]          = -1,
+    [OP_GREATER]        = -1,
+    [OP_LESS]           = -1,
+    [OP_GREATER_EQUAL]  = -1,
+    [OP_LESS_EQUAL]     = -1,
+    [OP_NOT_EQUAL]      = -1,
+    [OP_POP]            = -1,
+    [OP_DEFINE_GLOBAL]  = -1,
+    [OP_GET_GLOBAL]     = 1,
+    [OP_SET_GLOBAL]     = 0,
+    [OP_GET_LOCAL]      = 1,
+    [OP_SET_LOCAL]      = 0,
+    [OP_POPN]           = 0, // adjusted by its operand
+};
+
+/* Superinstruction for each fusable pair of opcodes, or 0
+ * (no base opcode is ever fused) for none.
+ */
+static const uint8_t superinstructions[OP_COUNT][OP_COUNT] = {
+#define SUPERINSTRUCTION(name, first, second, operand) [first][second] = name,
+#include "superinstructions.h"
+#undef SUPERINSTRUCTION
+};
 
 ParseRule rules[] = {
   [TOKEN_LEFT_PAREN]    = {grouping, NULL,   PREC_NONE},
@@ -49,8 +113,8 @@ ParseRule rules[] = {
   [TOKEN_GREATER_EQUAL] = {NULL,     binary, PREC_COMPARISON},
   [TOKEN_LESS]          = {NULL,     binary, PREC_COMPARISON},
   [TOKEN_LESS_EQUAL]    = {NULL,     binary, PREC_COMPARISON},
-  [TOKEN_IDENTIFIER]    = {NULL,     NULL,   PREC_NONE},
-  [TOKEN_STRING]        = {NULL,     NULL,   PREC_NONE},
+  [TOKEN_IDENTIFIER]    = {variable, NULL,   PREC_NONE},
+  [TOKEN_STRING]        = {string,   NULL,   PREC_NONE},
   [TOKEN_NUMBER]        = {number,   NULL,   PREC_NONE},
   [TOKEN_AND]           = {NULL,     NULL,   PREC_NONE},
   [TOKEN_CLASS]         = {NULL,     NULL,   PREC_NONE},
@@ -72,93 +136,392 @@ ParseRule rules[] = {
   [TOKEN_EOF]           = {NULL,     NULL,   PREC_NONE},
 };
 
+/* Register mode. The source is compiled to stack code as
+ * usual and then lowered by lower_to_registers().
+ */
+bool compile_registers(const char* source, size_t length, RegisterChunk* chunk, Heap* heap,
+    Table* globals, FILE* errors) {
+    Chunk stack_chunk;
+    init_chunk(&stack_chunk);
+    // Lowering reads base opcodes only.
+    bool compiled = compile_chunk(source, length, &stack_chunk, heap, globals, errors, false) &&
+        lower_to_registers(&stack_chunk, chunk, errors);
+    free_chunk(&stack_chunk);
+
+    if(compiled && debug_options.print_code) {
+        disassemble_register_chunk(chunk, "registers");
+    }
+    return compiled;
+}
+
+
 /* Compiler. Takes the scanned tokens from the scanner
- * and interprets their symbols into bytecode.
+ * and interprets their symbols into bytecode. All state
+ * lives in a local Parser, so separate threads may compile
+ * at once. Errors are reported to the errors stream, and
+ * string constants are allocated in heap.
+ *
+ * Global variables are resolved to slots here. Each name is
+ * given the next free slot of globals the first time it is
+ * mentioned, and the chunk's global_count says how many
+ * slots its code may touch. Chunks compiled against the
+ * same table agree on every slot, which is how the REPL
+ * keeps its variables from line to line. Variables declared
+ * inside a block are locals instead: they live in the VM
+ * stack slot their initializer was computed in and are
+ * popped when the block ends.
+ *
+ * A script is a list of declarations and statements. The
+ * value of its last expression statement, with or without
+ * the ';', is the value it returns.
+ */
+bool compile(const char* source, size_t length, Chunk* chunk, Heap* heap, Table* globals,
+    FILE* errors) {
+    return compile_chunk(source, length, chunk, heap, globals, errors, true);
+}
+
+
+static bool compile_chunk(const char* source, size_t length, Chunk* chunk, Heap* heap,
+    Table* globals, FILE* errors, bool superinstructions) {
+    Parser state;
+    Parser* parser = &state;
+    init_scanner(&parser->scanner, source, length);
+    parser->errors = errors;
+    parser->heap = heap;
+    parser->globals = globals;
+    parser->superinstructions = superinstructions;
+    parser->compiling_chunk = chunk;
+    parser->had_error = parser->panic_mode = false;
+    parser->pending_count = 0;
+    parser->stack_height = 0;
+    parser->local_count = 0;
+    parser->scope_depth = 0;
+    advance(parser);
+    bool has_value = false;
+    while(!match(parser, TOKEN_EOF)) {
+        has_value = declaration(parser);
+    }
+    // A script that ends in anything but an expression returns null.
+    if(!has_value) emit_constant(parser, NULL_VAL);
+    end_compiler(parser);
+    return !parser->had_error;
+}
+
+
+static bool check(Parser* parser, TokenType type) {
+    return parser->current.type == type;
+}
+
+
+static bool match(Parser* parser, TokenType type) {
+    if(!check(parser, type)) return false;
+    advance(parser);
+    return true;
+}
+
+
+/* Returns true if the declaration left the script's value
+ * on the stack.
  */
-bool compile(const char* source, Chunk* chunk) {
-    init_scanner(source);
-    parser.compiling_chunk = chunk;
-    parser.had_error = parser.panic_mode = false;
-    advance();
-    expression();
-    consume(TOKEN_EOF, "Expect end of expression.");
-    end_compiler();
-    return !parser.had_error;
+static bool declaration(Parser* parser) {
+    bool has_value = false;
+    if(match(parser, TOKEN_VAR)) {
+        var_declaration(parser);
+    } else {
+        has_value = statement(parser);
+    }
+    if(parser->panic_mode) synchronize(parser);
+    return has_value;
 }
 
 
-static void consume(TokenType type, const char* message) {
-    if(parser.current.type == type) {
-        advance();
+static void var_declaration(Parser* parser) {
+    consume(parser, TOKEN_IDENTIFIER, "Expect variable name.");
+    Token name = parser->previous;
+    int local = parser->scope_depth > 0 ? declare_local(parser, &name) : -1;
+    if(match(parser, TOKEN_EQUAL)) {
+        expression(parser);
+    } else {
+        emit_constant(parser, NULL_VAL);
+    }
+    consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
+
+    if(parser->scope_depth > 0) {
+        // The initializer's value already sits in the local's slot.
+        if(local != -1) parser->locals[local].depth = parser->scope_depth;
         return;
     }
-    error_at_current(message);
+    emit_global_op(parser, OP_DEFINE_GLOBAL, global_slot(parser, &name));
 }
 
 
-static void parse_precedence(Precedence precedence) {
-    advance();
-    ParseFn prefix_rule = get_rule(parser.previous.type)->prefix;
+static bool statement(Parser* parser) {
+    if(match(parser, TOKEN_LEFT_BRACE)) {
+        begin_scope(parser);
+        block(parser);
+        end_scope(parser);
+        return false;
+    }
+    return expression_statement(parser);
+}
+
+
+/* The last statement of a script keeps its value on the
+ * stack for OP_RETURN and may leave out the ';'. Any other
+ * value is popped, or never loaded if it folded to a
+ * constant.
+ */
+static bool expression_statement(Parser* parser) {
+    int pending_count = parser->pending_count;
+    int code_count = current_chunk(parser)->count;
+    expression(parser);
+    if(!check(parser, TOKEN_EOF)) {
+        consume(parser, TOKEN_SEMICOLON, "Expect ';' after expression.");
+    }
+    if(check(parser, TOKEN_EOF) && parser->scope_depth == 0) return true;
+
+    if(folding_operand(parser, pending_count, code_count) != NULL) {
+        parser->pending_count -= 1;
+    } else {
+        emit_op(parser, OP_POP);
+    }
+    return false;
+}
+
+
+static void block(Parser* parser) {
+    while(!check(parser, TOKEN_RIGHT_BRACE) && !check(parser, TOKEN_EOF)) {
+        declaration(parser);
+    }
+    consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after block.");
+}
+
+
+static void begin_scope(Parser* parser) {
+    parser->scope_depth += 1;
+}
+
+
+/* Drops the block's locals, with one instruction for every
+ * UINT8_MAX of them: a block may hold MAX_LOCALS, one more
+ * than OP_POPN's operand can count.
+ */
+static void end_scope(Parser* parser) {
+    parser->scope_depth -= 1;
+    int count = 0;
+    while(parser->local_count > 0 &&
+        parser->locals[parser->local_count - 1].depth > parser->scope_depth) {
+        parser->local_count -= 1;
+        count += 1;
+    }
+    while(count > 0) {
+        int popped = count < UINT8_MAX ? count : UINT8_MAX;
+        if(popped == 1) {
+            emit_op(parser, OP_POP);
+        } else {
+            emit_byte_op(parser, OP_POPN, (uint8_t) popped);
+            adjust_stack(parser, -popped);
+        }
+        count -= popped;
+    }
+}
+
+
+/* Skips to the next statement after a syntax error, so one
+ * mistake is reported once.
+ */
+static void synchronize(Parser* parser) {
+    parser->panic_mode = false;
+    while(parser->current.type != TOKEN_EOF) {
+        if(parser->previous.type == TOKEN_SEMICOLON) return;
+        if(parser->current.type == TOKEN_VAR) return;
+        if(parser->current.type == TOKEN_RIGHT_BRACE) return; // let the block close
+        advance(parser);
+    }
+}
+
+
+static void consume(Parser* parser, TokenType type, const char* message) {
+    if(parser->current.type == type) {
+        advance(parser);
+        return;
+    }
+    error_at_current(parser, message);
+}
+
+
+static void parse_precedence(Parser* parser, Precedence precedence) {
+    advance(parser);
+    ParseFn prefix_rule = get_rule(parser->previous.type)->prefix;
     if(prefix_rule == NULL) {
-        error("Expect expression.");
+        error(parser, "Expect expression.");
         return;
     }
 
-    prefix_rule();
-    while(precedence <= get_rule(parser.current.type)->precedence) {
-        advance();
-        ParseFn infix_rule = get_rule(parser.previous.type)->infix;
-        infix_rule();
+    bool can_assign = precedence <= PREC_ASSIGNMENT;
+    prefix_rule(parser, can_assign);
+    while(precedence <= get_rule(parser->current.type)->precedence) {
+        advance(parser);
+        ParseFn infix_rule = get_rule(parser->previous.type)->infix;
+        infix_rule(parser, can_assign);
+    }
+
+    if(can_assign && match(parser, TOKEN_EQUAL)) {
+        error(parser, "Invalid assignment target.");
+    }
+}
+
+static void expression(Parser* parser) {
+    parse_precedence(parser, PREC_ASSIGNMENT);
+}
+
+
+static void variable(Parser* parser, bool can_assign) {
+    Token name = parser->previous;
+    int local = resolve_local(parser, &name);
+    if(local >= 0) {
+        if(can_assign && match(parser, TOKEN_EQUAL)) {
+            expression(parser);
+            emit_byte_op(parser, OP_SET_LOCAL, (uint8_t) local);
+        } else {
+            emit_byte_op(parser, OP_GET_LOCAL, (uint8_t) local);
+        }
+        return;
+    }
+
+    uint16_t slot = global_slot(parser, &name);
+    if(can_assign && match(parser, TOKEN_EQUAL)) {
+        expression(parser);
+        emit_global_op(parser, OP_SET_GLOBAL, slot);
+    } else {
+        emit_global_op(parser, OP_GET_GLOBAL, slot);
     }
 }
 
-static void expression() {
-    parse_precedence(PREC_ASSIGNMENT);
+
+static bool identifiers_equal(Token* a, Token* b) {
+    return a->length == b->length && memcmp(a->start, b->start, a->length) == 0;
 }
 
 
-static void grouping() {
-    expression();
-    consume(TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+/* Adds an uninitialized local and returns its index, or -1
+ * when there is no room for it.
+ */
+static int declare_local(Parser* parser, Token* name) {
+    for(int i = parser->local_count - 1; i >= 0; i--) {
+        Local* local = &parser->locals[i];
+        if(local->depth != -1 && local->depth < parser->scope_depth) break;
+        if(identifiers_equal(name, &local->name)) {
+            error(parser, "Already a variable with this name in this scope.");
+        }
+    }
+
+    if(parser->local_count == MAX_LOCALS) {
+        error(parser, "Too many local variables.");
+        return -1;
+    }
+    Local* local = &parser->locals[parser->local_count];
+    local->name = *name;
+    local->depth = -1;
+    return parser->local_count++;
 }
 
 
-static void emit_bytes(uint8_t byte1, uint8_t byte2) {
-    emit_byte(byte1);
-    emit_byte(byte2);
+/* Returns the stack slot of the innermost local called
+ * name, or -1 for a global.
+ */
+static int resolve_local(Parser* parser, Token* name) {
+    for(int i = parser->local_count - 1; i >= 0; i--) {
+        Local* local = &parser->locals[i];
+        if(identifiers_equal(name, &local->name)) {
+            if(local->depth == -1) {
+                error(parser, "Can't read local variable in its own initializer.");
+            }
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/* Returns the slot of a global, giving the name the next
+ * free one if it has none. Names are never removed, so the
+ * slots stay dense.
+ */
+static uint16_t global_slot(Parser* parser, Token* name) {
+    ObjString* string = copy_string(parser->heap, name->start, name->length);
+    Value slot;
+    if(table_get(parser->globals, string, &slot)) return (uint16_t) AS_INT(slot);
+
+    if(parser->globals->count > UINT16_MAX) {
+        error(parser, "Too many global variables.");
+        return 0;
+    }
+    int index = parser->globals->count;
+    table_set(parser->globals, string, INT_VAL(index));
+    return (uint16_t) index;
+}
+
+static void grouping(Parser* parser, bool can_assign) {
+    expression(parser);
+    consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
 }
 
 
-static void binary() {
-    TokenType operator_type = parser.previous.type;
+static void binary(Parser* parser, bool can_assign) {
+    TokenType operator_type = parser->previous.type;
     ParseRule* rule = get_rule(operator_type);
-    parse_precedence((Precedence) (rule->precedence + 1));
+    int pending_count = parser->pending_count;
+    int code_count = current_chunk(parser)->count;
+    parse_precedence(parser, (Precedence) (rule->precedence + 1));
+
+    if(fold_binary(parser, operator_type, pending_count, code_count)) return;
 
     switch(operator_type) {
-        case TOKEN_PLUS:            emit_byte(OP_ADD); break;
-        case TOKEN_MINUS:           emit_byte(OP_SUBTRACT); break;
-        case TOKEN_STAR:            emit_byte(OP_MULTIPLY); break;
-        case TOKEN_SLASH:           emit_byte(OP_DIVIDE); break;
-        case TOKEN_BANG_EQUAL:      emit_bytes(OP_EQUAL, OP_NOT); break;
-        case TOKEN_EQUAL_EQUAL:     emit_byte(OP_EQUAL); break;
-        case TOKEN_GREATER:         emit_byte(OP_GREATER); break;
-        case TOKEN_GREATER_EQUAL:   emit_bytes(OP_LESS, OP_NOT); break;
-        case TOKEN_LESS:            emit_byte(OP_LESS); break;
-        case TOKEN_LESS_EQUAL:      emit_bytes(OP_GREATER, OP_NOT); break;
+        case TOKEN_PLUS:            emit_op(parser, OP_ADD); break;
+        case TOKEN_MINUS:           emit_op(parser, OP_SUBTRACT); break;
+        case TOKEN_STAR:            emit_op(parser, OP_MULTIPLY); break;
+        case TOKEN_SLASH:           emit_op(parser, OP_DIVIDE); break;
+        case TOKEN_BANG_EQUAL:      emit_op(parser, OP_NOT_EQUAL); break;
+        case TOKEN_EQUAL_EQUAL:     emit_op(parser, OP_EQUAL); break;
+        case TOKEN_GREATER:         emit_op(parser, OP_GREATER); break;
+        case TOKEN_GREATER_EQUAL:   emit_op(parser, OP_GREATER_EQUAL); break;
+        case TOKEN_LESS:            emit_op(parser, OP_LESS); break;
+        case TOKEN_LESS_EQUAL:      emit_op(parser, OP_LESS_EQUAL); break;
         default: return;
     }
 }
 
 
-static void unary() {
-    TokenType operator_type = parser.previous.type;
+static void unary(Parser* parser, bool can_assign) {
+    TokenType operator_type = parser->previous.type;
+    int pending_count = parser->pending_count;
+    int code_count = current_chunk(parser)->count;
 
     /* Compile the operand. */
-    parse_precedence(PREC_UNARY);
+    parse_precedence(parser, PREC_UNARY);
+
+    PendingConstant* operand = folding_operand(parser, pending_count, code_count);
+    if(operand != NULL) {
+        int64_t negated;
+        if(operator_type == TOKEN_MINUS && IS_INT(operand->value) &&
+            int_negate(AS_INT(operand->value), &negated)) {
+            operand->value = INT_VAL(negated);
+            return;
+        }
+        if(operator_type == TOKEN_MINUS && IS_NUMBER(operand->value)) {
+            operand->value = NUMBER_VAL(-AS_NUMBER(operand->value));
+            return;
+        }
+        if(operator_type == TOKEN_BANG) {
+            operand->value = BOOL_VAL(is_falsey(operand->value));
+            return;
+        }
+    }
 
     switch(operator_type) {
-        case TOKEN_MINUS: emit_byte(OP_NEGATE); break;
-        case TOKEN_BANG: emit_byte(OP_NOT); break;
+        case TOKEN_MINUS: emit_op(parser, OP_NEGATE); break;
+        case TOKEN_BANG: emit_op(parser, OP_NOT); break;
         default: return;
     }
 }
@@ -169,106 +532,503 @@ static ParseRule* get_rule(TokenType type) {
 }
 
 
-static void emit_byte(uint8_t byte) {
-    write_chunk(current_chunk(), byte, parser.previous.line);
+static void emit_byte(Parser* parser, uint8_t byte) {
+    flush_constants(parser);
+    write_chunk(current_chunk(parser), byte, parser->previous.line);
+}
+
+
+static void emit_op(Parser* parser, OpCode op) {
+    emit_byte(parser, op);
+    adjust_stack(parser, stack_effects[op]);
 }
 
 
-static void end_compiler() {
-    emit_return();
-    #ifdef DEBUG_PRINT_CODE
-    if(!parser.had_error) {
-        disassemble_chunk(current_chunk(), "code");
+static void emit_byte_op(Parser* parser, OpCode op, uint8_t operand) {
+    emit_op(parser, op);
+    emit_byte(parser, operand);
+}
+
+
+static void emit_global_op(Parser* parser, OpCode op, uint16_t slot) {
+    emit_op(parser, op);
+    emit_byte(parser, (slot & 0xFF00) >> 8);
+    emit_byte(parser, slot & 0x00FF);
+}
+
+
+/* Tracks the stack height the emitted code will reach and
+ * records the maximum in the chunk, so the VM can reserve
+ * the whole stack before running it.
+ */
+static void adjust_stack(Parser* parser, int effect) {
+    parser->stack_height += effect;
+    Chunk* chunk = current_chunk(parser);
+    if(parser->stack_height > chunk->max_stack) {
+        chunk->max_stack = parser->stack_height;
+        if(chunk->max_stack == STACK_MAX + 1) {
+            error(parser, "Expression needs too much stack space.");
+        }
+    }
+}
+
+
+static void end_compiler(Parser* parser) {
+    emit_return(parser);
+    current_chunk(parser)->global_count = parser->globals->count;
+    if(parser->superinstructions && !parser->had_error) {
+        select_superinstructions(current_chunk(parser));
+    }
+    if(!debug_options.print_code) return;
+    if(!parser->had_error) {
+        disassemble_chunk(current_chunk(parser), "code");
     } else {
-        fprintf(stderr, "Error: Could not disassemble chunk due to error.\n");
+        fprintf(parser->errors, "Error: Could not disassemble chunk due to error.\n");
+    }
+}
+
+
+/* Literals without a fraction are ints unless they are too
+ * large for one.
+ */
+static void number(Parser* parser, bool can_assign) {
+    int64_t integer;
+    if(parse_integer(parser->previous.start, parser->previous.length, &integer) &&
+        INT_FITS(integer)) {
+        emit_constant(parser, INT_VAL(integer));
+        return;
     }
-    #endif
+    double value = parse_number(parser->previous.start, parser->previous.length);
+    emit_constant(parser, NUMBER_VAL(value));
+}
+
+
+/* The token still has its quotes. */
+static void string(Parser* parser, bool can_assign) {
+    ObjString* string = copy_string(parser->heap, parser->previous.start + 1,
+        parser->previous.length - 2);
+    emit_constant(parser, OBJ_VAL(string));
 }
 
 
-static void number() {
-    double value = strtod(parser.previous.start, NULL);
-    emit_constant(NUMBER_VAL(value));
+/* Constants are not written immediately. They wait on the
+ * parser's pending list until some other instruction is
+ * emitted, so that operators applied to them can be folded.
+ */
+static void emit_constant(Parser* parser, Value value) {
+    if(parser->pending_count == MAX_PENDING_CONSTANTS) flush_constants(parser);
+    PendingConstant* constant = &parser->pending[parser->pending_count++];
+    constant->value = value;
+    constant->line = parser->previous.line;
 }
 
 
-static void emit_constant(Value value) {
-    uint16_t index = make_constant(value);
+static void flush_constants(Parser* parser) {
+    int count = parser->pending_count;
+    parser->pending_count = 0;
+    for(int i = 0; i < count; i++) {
+        write_constant_load(parser, parser->pending[i].value, parser->pending[i].line);
+    }
+}
+
+
+static void write_constant_load(Parser* parser, Value value, int line) {
+    Chunk* chunk = current_chunk(parser);
+    adjust_stack(parser, 1);
+    if(IS_NULL(value)) {
+        write_chunk(chunk, OP_NULL, line);
+        return;
+    }
+    if(IS_BOOL(value)) {
+        write_chunk(chunk, AS_BOOL(value) ? OP_TRUE : OP_FALSE, line);
+        return;
+    }
+
+    uint16_t index = make_constant(parser, value);
     if(index > UINT8_MAX) {
         /* Write 16-bit index. */
         uint8_t left_bits = (index & 0xFF00) >> 8;
-        emit_bytes(OP_CONSTANT_LONG, left_bits);
-        emit_byte((uint8_t) (index & 0x00FF));
+        write_chunk(chunk, OP_CONSTANT_LONG, line);
+        write_chunk(chunk, left_bits, line);
+        write_chunk(chunk, (uint8_t) (index & 0x00FF), line);
     } else {
-        emit_bytes(OP_CONSTANT, (uint8_t) (index & 0x00FF));
+        write_chunk(chunk, OP_CONSTANT, line);
+        write_chunk(chunk, (uint8_t) (index & 0x00FF), line);
     }
-    
 }
 
 
-static uint16_t make_constant(Value value) {
-    int constant = add_constant(current_chunk(), value);
+/* Returns the constant an operand compiled to, or NULL if
+ * it emitted any code. The counts are taken before the
+ * operand was parsed.
+ */
+static PendingConstant* folding_operand(Parser* parser, int pending_count, int code_count) {
+    if(parser->pending_count != pending_count + 1) return NULL;
+    if(current_chunk(parser)->count != code_count) return NULL;
+    return &parser->pending[pending_count];
+}
+
+
+/* Folds a binary operator whose operands are both pending
+ * constants. Type mismatches are left for the VM so they
+ * raise the same runtime error as before.
+ */
+static bool fold_binary(Parser* parser, TokenType operator_type, int pending_count, int code_count) {
+    if(pending_count == 0) return false;
+    PendingConstant* right = folding_operand(parser, pending_count, code_count);
+    if(right == NULL) return false;
+    PendingConstant* left = &parser->pending[pending_count - 1];
+
+    Value a = left->value;
+    Value b = right->value;
+    Value result;
+    switch(operator_type) {
+        case TOKEN_BANG_EQUAL:  result = BOOL_VAL(!values_equal(a, b)); break;
+        case TOKEN_EQUAL_EQUAL: result = BOOL_VAL(values_equal(a, b)); break;
+        default: {
+            if(operator_type == TOKEN_PLUS && IS_STRING(a) && IS_STRING(b)) {
+                result = OBJ_VAL(concatenate_strings(parser->heap, AS_STRING(a), AS_STRING(b)));
+                break;
+            }
+            if(!IS_NUMBER(a) || !IS_NUMBER(b)) return false;
+            if(IS_INT(a) && IS_INT(b) &&
+                fold_integers(operator_type, AS_INT(a), AS_INT(b), &result)) break;
+            double x = AS_NUMBER(a);
+            double y = AS_NUMBER(b);
+            switch(operator_type) {
+                case TOKEN_PLUS:            result = NUMBER_VAL(x + y); break;
+                case TOKEN_MINUS:           result = NUMBER_VAL(x - y); break;
+                case TOKEN_STAR:            result = NUMBER_VAL(x * y); break;
+                case TOKEN_SLASH:           result = NUMBER_VAL(x / y); break;
+                case TOKEN_GREATER:         result = BOOL_VAL(x > y); break;
+                case TOKEN_GREATER_EQUAL:   result = BOOL_VAL(x >= y); break;
+                case TOKEN_LESS:            result = BOOL_VAL(x < y); break;
+                case TOKEN_LESS_EQUAL:      result = BOOL_VAL(x <= y); break;
+                default: return false;
+            }
+        }
+    }
+
+    left->value = result;
+    parser->pending_count -= 1;
+    return true;
+}
+
+
+/* Folds an operator on two ints the way the VM's integer
+ * fast paths run it. Returns false where the VM falls back
+ * to doubles.
+ */
+static bool fold_integers(TokenType operator_type, int64_t x, int64_t y, Value* result) {
+    int64_t value;
+    switch(operator_type) {
+        case TOKEN_PLUS:            if(!int_add(x, y, &value)) return false; break;
+        case TOKEN_MINUS:           if(!int_subtract(x, y, &value)) return false; break;
+        case TOKEN_STAR:            if(!int_multiply(x, y, &value)) return false; break;
+        case TOKEN_SLASH:           if(!int_divide(x, y, &value)) return false; break;
+        case TOKEN_GREATER:         *result = BOOL_VAL(x > y); return true;
+        case TOKEN_GREATER_EQUAL:   *result = BOOL_VAL(x >= y); return true;
+        case TOKEN_LESS:            *result = BOOL_VAL(x < y); return true;
+        case TOKEN_LESS_EQUAL:      *result = BOOL_VAL(x <= y); return true;
+        default: return false;
+    }
+    *result = INT_VAL(value);
+    return true;
+}
+
+
+static uint16_t make_constant(Parser* parser, Value value) {
+    int constant = add_constant(current_chunk(parser), value);
     if(constant > UINT16_MAX) {
-        error("Too many constants in one chunk.");
+        error(parser, "Too many constants in one chunk.");
     }
 
     return (uint16_t) constant;
 }
 
-static void emit_return() {
-    emit_byte(OP_RETURN);
+static void emit_return(Parser* parser) {
+    emit_op(parser, OP_RETURN);
 }
 
 
-static Chunk* current_chunk() {
-    return parser.compiling_chunk;
+static Chunk* current_chunk(Parser* parser) {
+    return parser->compiling_chunk;
 }
 
 
-static void advance() {
-    parser.previous = parser.current;
+static void advance(Parser* parser) {
+    parser->previous = parser->current;
 
     for(;;) {
-        parser.current = scan_token();
-        if(parser.current.type != TOKEN_ERROR) break;
-        error_at_current(parser.current.start);
+        parser->current = scan_token(&parser->scanner);
+        if(parser->current.type != TOKEN_ERROR) break;
+        error_at_current(parser, parser->current.start);
     }
 }
 
 
-static void error_at_current(const char* message) {
-    error_at(&parser.current, message);
+static void error_at_current(Parser* parser, const char* message) {
+    error_at(parser, &parser->current, message);
 }
 
 
-static void error(const char* message) {
-    error_at(&parser.previous, message);
+static void error(Parser* parser, const char* message) {
+    error_at(parser, &parser->previous, message);
 }
 
 
-static void error_at(Token* token, const char* message) {
-    if(parser.panic_mode) return;
-    parser.panic_mode = true;
-    fprintf(stderr, "[line %d] Error", token->line);
+static void error_at(Parser* parser, Token* token, const char* message) {
+    if(parser->panic_mode) return;
+    parser->panic_mode = true;
+    fprintf(parser->errors, "[line %d] Error", token->line);
 
     if(token->type == TOKEN_EOF) {
-        fprintf(stderr, " at end");
+        fprintf(parser->errors, " at end");
     } else if(token->type == TOKEN_ERROR) {
         // Do nothing.
     } else {
-        fprintf(stderr, " at '%.*s'", token->length, token->start);
+        fprintf(parser->errors, " at '%.*s'", token->length, token->start);
     }
 
-    fprintf(stderr, ": %s\n", message);
-    parser.had_error = true;
+    fprintf(parser->errors, ": %s\n", message);
+    parser->had_error = true;
 }
 
 
-static void literal() {
-    switch(parser.previous.type) {
-        case TOKEN_FALSE: emit_byte(OP_FALSE); break;
-        case TOKEN_NULL:  emit_byte(OP_NULL);  break;
-        case TOKEN_TRUE:  emit_byte(OP_TRUE);  break;
+static void literal(Parser* parser, bool can_assign) {
+    switch(parser->previous.type) {
+        case TOKEN_FALSE: emit_constant(parser, BOOL_VAL(false)); break;
+        case TOKEN_NULL:  emit_constant(parser, NULL_VAL);  break;
+        case TOKEN_TRUE:  emit_constant(parser, BOOL_VAL(true));  break;
         default: return;
     }
+}
+
+
+/* Rewrites each fusable pair of adjacent instructions into
+ * its superinstruction, left to right, compacting the code
+ * and its line table in place. The fused instruction keeps
+ * the line of its first half. Chunks have no jumps yet, so
+ * no instruction boundary needs to survive.
+ */
+void select_superinstructions(Chunk* chunk) {
+    int line_count = chunk->line_count;
+    LineStart* lines = reallocate(NULL, 0, line_count * sizeof(LineStart));
+    memcpy(lines, chunk->lines, line_count * sizeof(LineStart));
+
+    int count = chunk->count;
+    chunk->count = 0;
+    chunk->line_count = 0;
+    int run = 0;
+    // The write offset never passes the read offset.
+    for(int offset = 0; offset < count;) {
+        while(run + 1 < line_count && lines[run + 1].offset <= offset) run += 1;
+        int line = lines[run].line;
+
+        uint8_t instruction = chunk->code[offset];
+        int length = instruction_length(instruction);
+        int next = offset + length;
+        uint8_t fused = next < count ? superinstructions[instruction][chunk->code[next]] : 0;
+        write_chunk(chunk, fused != 0 ? fused : instruction, line);
+        for(int i = 1; i < length; i++) write_chunk(chunk, chunk->code[offset + i], line);
+        offset = fused != 0 ? next + 1 : next;
+    }
+
+    reallocate(lines, line_count * sizeof(LineStart), 0);
+}
+
+
+static bool constant_operand(RegisterChunk* target, Value value, uint16_t* operand,
+    FILE* errors) {
+    size_t index = add_constant(&target->chunk, value);
+    if(index > MAX_REGISTER_OPERAND) {
+        fprintf(errors, "Error: Too many constants for register mode.\n");
+        return false;
+    }
+    *operand = (uint16_t) index | RK_CONSTANT;
+    return true;
+}
+
+
+static void write_operand(Chunk* chunk, uint16_t operand, int line) {
+    write_chunk(chunk, (operand & 0xFF00) >> 8, line);
+    write_chunk(chunk, operand & 0x00FF, line);
+}
+
+
+static RegOpCode register_opcode(uint8_t instruction) {
+    switch(instruction) {
+        case OP_NEGATE:         return ROP_NEGATE;
+        case OP_NOT:            return ROP_NOT;
+        case OP_ADD:            return ROP_ADD;
+        case OP_SUBTRACT:       return ROP_SUBTRACT;
+        case OP_MULTIPLY:       return ROP_MULTIPLY;
+        case OP_DIVIDE:         return ROP_DIVIDE;
+        case OP_EQUAL:          return ROP_EQUAL;
+        case OP_NOT_EQUAL:      return ROP_NOT_EQUAL;
+        case OP_GREATER:        return ROP_GREATER;
+        case OP_LESS:           return ROP_LESS;
+        case OP_GREATER_EQUAL:  return ROP_GREATER_EQUAL;
+        case OP_LESS_EQUAL:     return ROP_LESS_EQUAL;
+        default:                return ROP_RETURN;
+    }
+}
+
+
+/* Stores operand into register slot, the home of a local.
+ * Entries above that still read the local's old value
+ * through its register get a copy of it first, in the
+ * register of their own slot, which nothing else reads.
+ */
+static void lower_set_local(Chunk* chunk, uint16_t* stack, int depth, uint16_t slot,
+    uint16_t operand, int line) {
+    if(operand == slot) return;
+    for(int i = 0; i < depth; i++) {
+        if(i == slot || stack[i] != slot) continue;
+        write_chunk(chunk, ROP_MOVE, line);
+        write_operand(chunk, i, line);
+        write_operand(chunk, slot, line);
+        stack[i] = i;
+    }
+    write_chunk(chunk, ROP_MOVE, line);
+    write_operand(chunk, slot, line);
+    write_operand(chunk, operand, line);
+    stack[slot] = slot;
+}
+
+
+/* Replays stack code against a virtual stack of operands.
+ * Loads only push a constant operand; an operator pops its
+ * operands and writes its result to the register numbered
+ * by the stack slot it would have occupied. A local lives
+ * in the register of its stack slot, so reading one pushes
+ * whatever operand that slot holds and only assignments
+ * move values. Globals are read into a register, since a
+ * later store could change them under the operand.
+ */
+bool lower_to_registers(Chunk* source, RegisterChunk* target, FILE* errors) {
+    uint16_t* stack = reallocate(NULL, 0, (source->count + 1) * sizeof(uint16_t));
+    int depth = 0;
+    bool lowered = true;
+    LineCursor cursor;
+    init_line_cursor(&cursor, source);
+    Chunk* chunk = &target->chunk;
+    chunk->global_count = source->global_count;
+
+    for(int offset = 0; lowered && offset < source->count;) {
+        uint8_t instruction = source->code[offset];
+        int line = cursor_line(&cursor, offset);
+        switch(instruction) {
+            case OP_CONSTANT: {
+                Value value = source->constants.values[source->code[offset + 1]];
+                lowered = constant_operand(target, value, &stack[depth++], errors);
+                offset += 2;
+                break;
+            }
+            case OP_CONSTANT_LONG: {
+                uint16_t index = (source->code[offset + 1] << 8) | source->code[offset + 2];
+                lowered = constant_operand(target, source->constants.values[index], &stack[depth++], errors);
+                offset += 3;
+                break;
+            }
+            case OP_NULL:
+            case OP_TRUE:
+            case OP_FALSE: {
+                Value value = instruction == OP_NULL ? NULL_VAL : BOOL_VAL(instruction == OP_TRUE);
+                lowered = constant_operand(target, value, &stack[depth++], errors);
+                offset += 1;
+                break;
+            }
+            case OP_NEGATE:
+            case OP_NOT: {
+                uint16_t operand = stack[--depth];
+                write_chunk(chunk, register_opcode(instruction), line);
+                write_operand(chunk, depth, line);
+                write_operand(chunk, operand, line);
+                stack[depth] = depth;
+                depth += 1;
+                offset += 1;
+                break;
+            }
+            case OP_ADD:
+            case OP_SUBTRACT:
+            case OP_MULTIPLY:
+            case OP_DIVIDE:
+            case OP_EQUAL:
+            case OP_NOT_EQUAL:
+            case OP_GREATER:
+            case OP_LESS:
+            case OP_GREATER_EQUAL:
+            case OP_LESS_EQUAL: {
+                uint16_t right = stack[--depth];
+                uint16_t left = stack[--depth];
+                write_chunk(chunk, register_opcode(instruction), line);
+                write_operand(chunk, depth, line);
+                write_operand(chunk, left, line);
+                write_operand(chunk, right, line);
+                stack[depth] = depth;
+                depth += 1;
+                offset += 1;
+                break;
+            }
+            case OP_POP:
+                depth -= 1;
+                offset += 1;
+                break;
+            case OP_POPN:
+                depth -= source->code[offset + 1];
+                offset += 2;
+                break;
+            case OP_GET_LOCAL:
+                stack[depth] = stack[source->code[offset + 1]];
+                depth += 1;
+                offset += 2;
+                break;
+            case OP_SET_LOCAL:
+                lower_set_local(chunk, stack, depth, source->code[offset + 1], stack[depth - 1], line);
+                offset += 2;
+                break;
+            case OP_GET_GLOBAL: {
+                write_chunk(chunk, ROP_GET_GLOBAL, line);
+                write_operand(chunk, depth, line);
+                write_chunk(chunk, source->code[offset + 1], line);
+                write_chunk(chunk, source->code[offset + 2], line);
+                stack[depth] = depth;
+                depth += 1;
+                offset += 3;
+                break;
+            }
+            case OP_DEFINE_GLOBAL:
+            case OP_SET_GLOBAL: {
+                // Defining pops the value; assigning leaves it as the result.
+                uint16_t operand = instruction == OP_DEFINE_GLOBAL ? stack[--depth] : stack[depth - 1];
+                write_chunk(chunk, instruction == OP_DEFINE_GLOBAL ? ROP_DEFINE_GLOBAL : ROP_SET_GLOBAL, line);
+                write_chunk(chunk, source->code[offset + 1], line);
+                write_chunk(chunk, source->code[offset + 2], line);
+                write_operand(chunk, operand, line);
+                offset += 3;
+                break;
+            }
+            case OP_RETURN: {
+                write_chunk(chunk, ROP_RETURN, line);
+                write_operand(chunk, stack[--depth], line);
+                offset += 1;
+                break;
+            }
+            default:
+                fprintf(errors, "Error: %s is not supported in register mode.\n",
+                    opcode_name(instruction));
+                lowered = false;
+                break;
+        }
+
+        if(depth > MAX_REGISTER_OPERAND) {
+            fprintf(errors, "Error: Too many registers for register mode.\n");
+            lowered = false;
+        }
+        if(depth > target->register_count) target->register_count = depth;
+    }
+
+    reallocate(stack, (source->count + 1) * sizeof(uint16_t), 0);
+    return lowered;
 }
\ No newline at end of file
@@ -1,6 +1,23 @@
 #include "debug.h"
+#include "regvm.h"
 
 
+DebugOptions debug_options = { false, false };
+
+static const char *opcode_names[] = {
+#define OPCODE(name, operand) [name] = #name,
+#include "opcodes.def"
+#undef OPCODE
+#define SUPERINSTRUCTION(name, first, second, operand) [name] = #name,
+#include "superinstructions.h"
+#undef SUPERINSTRUCTION
+};
+
+const char *opcode_name(int opcode) {
+    if(opcode < 0 || opcode >= OP_COUNT) return "OP_UNKNOWN";
+    return opcode_names[opcode];
+}
+
 static int simple_instruction(const char *name, int offset) {
     printf("%s\n", name);
     return offset + 1;
@@ -9,7 +26,7 @@ static int simple_instruction(const char *name, int offset) {
 static int constant_instruction(const char *name, Chunk *chunk, int offset) {
     uint8_t constant_index = chunk->code[offset + 1];
     printf("%-16s Index: %4d Value: ", name, constant_index);
-    print_value(chunk->constants.values[constant_index]);
+    print_value(stdout, chunk->constants.values[constant_index]);
     printf("\n");
     return offset + 2;
 }
@@ -17,64 +34,165 @@ static int constant_instruction(const char *name, Chunk *chunk, int offset) {
 static int constant_long_instruction(const char *name, Chunk *chunk, int offset) {
     uint16_t constant_index = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
     printf("%-16s Index: %4d Value: ", name, constant_index);
-    print_value(chunk->constants.values[constant_index]);
+    print_value(stdout, chunk->constants.values[constant_index]);
     printf("\n");
     return offset + 3;
 }
 
+static int global_instruction(const char *name, Chunk *chunk, int offset) {
+    uint16_t slot = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+    printf("%-16s Slot: %5d\n", name, slot);
+    return offset + 3;
+}
+
+static int byte_instruction(const char *name, const char *operand, Chunk *chunk, int offset) {
+    printf("%-16s %s: %4d\n", name, operand, chunk->code[offset + 1]);
+    return offset + 2;
+}
+
+static int disassemble_at(Chunk *chunk, int offset, int line, int previous_line);
+
 void disassemble_chunk(Chunk *chunk, const char *name) {
     printf("===== %s =====\n", name);
     
+    LineCursor cursor;
+    init_line_cursor(&cursor, chunk);
+    int previous_line = -1;
 
     for (int offset = 0; offset < chunk->count;) {
-        // NOTE: disassemble_instruction increments offset.
-        offset = disassemble_instruction(chunk, offset);
+        int line = cursor_line(&cursor, offset);
+        // NOTE: disassemble_at increments offset.
+        offset = disassemble_at(chunk, offset, line, previous_line);
+        previous_line = line;
     }
 }
 
 int disassemble_instruction(Chunk *chunk, int offset) {
+    int previous_line = offset > 0 ? get_line(chunk, offset - 1) : -1;
+    return disassemble_at(chunk, offset, get_line(chunk, offset), previous_line);
+}
+
+static int disassemble_at(Chunk *chunk, int offset, int line, int previous_line) {
     printf("%04d ", offset);
-    if (offset > 0 &&
-        get_line(chunk, offset) == get_line(chunk, offset - 1)) {
+    if (offset > 0 && line == previous_line) {
             printf(" | ");
         } else {
-            printf("%2d ", get_line(chunk, offset));
+            printf("%2d ", line);
         }
 
+    // Superinstructions print with the operand of their first half.
     uint8_t instruction = chunk->code[offset];
+    if(instruction >= OP_COUNT) {
+        printf("Unknown opcode %d\n", instruction);
+        return offset + 1;
+    }
+    switch (opcode_operand(instruction)) {
+        case OPERAND_CONSTANT:
+            return constant_instruction(opcode_name(instruction), chunk, offset);
+        case OPERAND_CONSTANT_LONG:
+            return constant_long_instruction(opcode_name(instruction), chunk, offset);
+        case OPERAND_GLOBAL:
+            return global_instruction(opcode_name(instruction), chunk, offset);
+        case OPERAND_LOCAL:
+            return byte_instruction(opcode_name(instruction), "Slot", chunk, offset);
+        case OPERAND_COUNT:
+            return byte_instruction(opcode_name(instruction), "Count", chunk, offset);
+        default:
+            return simple_instruction(opcode_name(instruction), offset);
+    }
+}
+
+
+
+static void print_operand(RegisterChunk *chunk, uint16_t operand) {
+    if(operand & RK_CONSTANT) {
+        printf(" K%d(", operand & MAX_REGISTER_OPERAND);
+        print_value(stdout, chunk->chunk.constants.values[operand & MAX_REGISTER_OPERAND]);
+        printf(")");
+    } else {
+        printf(" R%d", operand);
+    }
+}
+
+static int register_instruction(const char *name, RegisterChunk *chunk, int offset) {
+    uint8_t *code = chunk->chunk.code;
+    int length = register_instruction_length(code[offset]);
+    printf("%-16s", name);
+    for(int i = offset + 1; i < offset + length; i += 2) {
+        print_operand(chunk, (uint16_t)((code[i] << 8) | code[i + 1]));
+    }
+    printf("\n");
+    return offset + length;
+}
+
+/* Like register_instruction(), for an instruction with a
+ * global slot as its first or second operand.
+ */
+static int register_global_instruction(const char *name, RegisterChunk *chunk, int offset,
+    int global_operand) {
+    uint8_t *code = chunk->chunk.code;
+    printf("%-16s", name);
+    for(int i = 0; i < 2; i++) {
+        uint16_t operand = (uint16_t)((code[offset + 1 + i * 2] << 8) | code[offset + 2 + i * 2]);
+        if(i == global_operand) {
+            printf(" G%d", operand);
+        } else {
+            print_operand(chunk, operand);
+        }
+    }
+    printf("\n");
+    return offset + 5;
+}
+
+void disassemble_register_chunk(RegisterChunk *chunk, const char *name) {
+    printf("===== %s (%d registers) =====\n", name, chunk->register_count);
+
+    for (int offset = 0; offset < chunk->chunk.count;) {
+        offset = disassemble_register_instruction(chunk, offset);
+    }
+}
+
+int disassemble_register_instruction(RegisterChunk *chunk, int offset) {
+    printf("%04d %2d ", offset, get_line(&chunk->chunk, offset));
+
+    uint8_t instruction = chunk->chunk.code[offset];
     switch (instruction) {
-        case OP_RETURN:
-            return simple_instruction("OP_RETURN", offset);
-        case OP_CONSTANT:
-            return constant_instruction("OP_CONSTANT", chunk, offset);
-        case OP_CONSTANT_LONG:
-            return constant_long_instruction("OP_CONSTANT_LONG", chunk, offset);
-        case OP_NEGATE:
-            return simple_instruction("OP_NEGATE", offset);
-        case OP_ADD:
-            return simple_instruction("OP_ADD", offset);
-        case OP_SUBTRACT:
-            return simple_instruction("OP_SUBTRACT", offset);
-        case OP_MULTIPLY:
-            return simple_instruction("OP_MULTIPLY", offset);
-        case OP_DIVIDE:
-            return simple_instruction("OP_DIVIDE", offset);
-        case OP_NULL:
-            return simple_instruction("OP_NULL", offset);
-        case OP_TRUE:
-            return simple_instruction("OP_TRUE", offset);
-        case OP_FALSE:
-            return simple_instruction("OP_FALSE", offset);
-        case OP_NOT:
-            return simple_instruction("OP_NOT", offset);
-        case OP_EQUAL:
-            return simple_instruction("OP_EQUAL", offset);
-        case OP_GREATER:
-            return simple_instruction("OP_GREATER", offset);
-        case OP_LESS:
-            return simple_instruction("OP_LESS", offset);
+        case ROP_RETURN:
+            return register_instruction("ROP_RETURN", chunk, offset);
+        case ROP_NEGATE:
+            return register_instruction("ROP_NEGATE", chunk, offset);
+        case ROP_NOT:
+            return register_instruction("ROP_NOT", chunk, offset);
+        case ROP_ADD:
+            return register_instruction("ROP_ADD", chunk, offset);
+        case ROP_SUBTRACT:
+            return register_instruction("ROP_SUBTRACT", chunk, offset);
+        case ROP_MULTIPLY:
+            return register_instruction("ROP_MULTIPLY", chunk, offset);
+        case ROP_DIVIDE:
+            return register_instruction("ROP_DIVIDE", chunk, offset);
+        case ROP_EQUAL:
+            return register_instruction("ROP_EQUAL", chunk, offset);
+        case ROP_NOT_EQUAL:
+            return register_instruction("ROP_NOT_EQUAL", chunk, offset);
+        case ROP_GREATER:
+            return register_instruction("ROP_GREATER", chunk, offset);
+        case ROP_LESS:
+            return register_instruction("ROP_LESS", chunk, offset);
+        case ROP_GREATER_EQUAL:
+            return register_instruction("ROP_GREATER_EQUAL", chunk, offset);
+        case ROP_LESS_EQUAL:
+            return register_instruction("ROP_LESS_EQUAL", chunk, offset);
+        case ROP_MOVE:
+            return register_instruction("ROP_MOVE", chunk, offset);
+        case ROP_GET_GLOBAL:
+            return register_global_instruction("ROP_GET_GLOBAL", chunk, offset, 1);
+        case ROP_DEFINE_GLOBAL:
+            return register_global_instruction("ROP_DEFINE_GLOBAL", chunk, offset, 0);
+        case ROP_SET_GLOBAL:
+            return register_global_instruction("ROP_SET_GLOBAL", chunk, offset, 0);
         default:
             printf("Unknown opcode %d\n", instruction);
             return offset + 1;
     }
-}
+}
\ No newline at end of file
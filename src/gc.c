@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "gc.h"
+#include "memory.h"
+#include "object.h"
+
+GcOptions gc_options = { GC_HEAP_GROWTH_FACTOR, GC_STEP_WORK };
+
+
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+
+void init_collector(Collector *gc) {
+    gc->phase = GC_IDLE;
+    gc->next_step = GC_MIN_HEAP;
+    gc->gray = NULL;
+    gc->gray_count = 0;
+    gc->gray_capacity = 0;
+    gc->names_entries = NULL;
+    gc->names_index = 0;
+    gc->globals_index = 0;
+    gc->constants_index = 0;
+    gc->sweep = NULL;
+    GcStats stats = {0};
+    gc->stats = stats;
+    gc->stats.started_ns = now_ns();
+}
+
+
+void free_collector(Collector *gc) {
+    reallocate(gc->gray, gc->gray_capacity * sizeof(Obj*), 0);
+    gc->gray = NULL;
+    gc->gray_count = 0;
+    gc->gray_capacity = 0;
+}
+
+
+/* Shades a white object gray. While sweeping, a white object
+ * may be one the sweep has yet to free; being found again
+ * brings it back, and since strings refer to nothing it can
+ * go straight to black. A survivor the sweep already whitened
+ * then waits one more collection at worst.
+ */
+void mark_object(Heap *heap, Obj *object) {
+    if(object == NULL || object->color != GC_WHITE) return;
+    Collector *gc = &heap->gc;
+    if(gc->phase == GC_SWEEP) {
+        object->color = GC_BLACK;
+        return;
+    }
+
+    object->color = GC_GRAY;
+    if(gc->gray_count == gc->gray_capacity) {
+        int capacity = gc->gray_capacity < INITIAL_GRAY_SIZE ?
+            INITIAL_GRAY_SIZE : gc->gray_capacity * GRAY_GROWTH_FACTOR;
+        gc->gray = reallocate(gc->gray, gc->gray_capacity * sizeof(Obj*), capacity * sizeof(Obj*));
+        gc->gray_capacity = capacity;
+    }
+    gc->gray[gc->gray_count++] = object;
+}
+
+
+void mark_value(Heap *heap, Value value) {
+    if(IS_OBJ(value)) mark_object(heap, AS_OBJ(value));
+}
+
+
+/* The running chunk changed, so a collection that is marking
+ * must scan the new chunk's constants from the start.
+ */
+void restart_constant_scan(Heap *heap) {
+    heap->gc.constants_index = 0;
+}
+
+
+/* Marks the references of a gray object. */
+static void blacken_object(Obj *object) {
+    switch(object->type) {
+        case OBJ_STRING: break;
+    }
+    object->color = GC_BLACK;
+}
+
+
+static size_t trace_gray(Heap *heap, size_t budget) {
+    Collector *gc = &heap->gc;
+    size_t work = 0;
+    while(gc->gray_count > 0 && work < budget) {
+        blacken_object(gc->gray[--gc->gray_count]);
+        work += 1;
+    }
+    return work;
+}
+
+
+/* Marks roots from where the cursors stopped, up to budget
+ * values. The names table moves its entries when it grows,
+ * so its cursor starts over when the entries change.
+ */
+static size_t mark_roots(Heap *heap, const Roots *roots, size_t budget) {
+    Collector *gc = &heap->gc;
+    size_t work = 0;
+    if(gc->names_entries != roots->names->entries) {
+        gc->names_entries = roots->names->entries;
+        gc->names_index = 0;
+    }
+    for(; gc->names_index < roots->names->capacity && work < budget; gc->names_index++) {
+        ObjString *key = roots->names->entries[gc->names_index].key;
+        if(key != NULL) mark_object(heap, &key->obj);
+        work += 1;
+    }
+    for(; gc->globals_index < roots->global_count && work < budget; gc->globals_index++) {
+        mark_value(heap, roots->globals[gc->globals_index]);
+        work += 1;
+    }
+    if(roots->constants == NULL) return work;
+    for(; gc->constants_index < roots->constants->count && work < budget; gc->constants_index++) {
+        mark_value(heap, roots->constants->values[gc->constants_index]);
+        work += 1;
+    }
+    return work;
+}
+
+
+static bool roots_marked(Heap *heap, const Roots *roots) {
+    Collector *gc = &heap->gc;
+    return gc->names_entries == roots->names->entries &&
+        gc->names_index >= roots->names->capacity &&
+        gc->globals_index >= roots->global_count &&
+        (roots->constants == NULL || gc->constants_index >= roots->constants->count) &&
+        gc->gray_count == 0;
+}
+
+
+static void begin_cycle(Heap *heap) {
+    Collector *gc = &heap->gc;
+    gc->phase = GC_MARK;
+    gc->names_entries = NULL;
+    gc->names_index = 0;
+    gc->globals_index = 0;
+    gc->constants_index = 0;
+}
+
+
+/* Ends marking. The stack, or the register VM's registers,
+ * changes on every instruction, so it is the one root marked
+ * all at once, here; it is no larger than the running
+ * chunk's max_stack or register count. Writes to globals are
+ * marked as they happen (see WRITE_GLOBAL in vm.c), and strings
+ * found through the intern table are marked when found, so
+ * nothing reachable is still white afterwards.
+ */
+static size_t finish_marking(Heap *heap, const Roots *roots) {
+    for(int i = 0; i < roots->stack_count; i++) mark_value(heap, roots->stack[i]);
+    size_t work = roots->stack_count + trace_gray(heap, SIZE_MAX);
+    heap->gc.phase = GC_SWEEP;
+    heap->gc.sweep = &heap->objects;
+    return work;
+}
+
+
+/* Frees white objects up to budget and whitens the rest for
+ * the next collection. A freed string leaves the intern
+ * table here, which is what makes the table weak.
+ */
+static size_t sweep(Heap *heap, size_t budget) {
+    Collector *gc = &heap->gc;
+    size_t work = 0;
+    while(*gc->sweep != NULL && work < budget) {
+        Obj *object = *gc->sweep;
+        work += 1;
+        if(object->color != GC_WHITE) {
+            object->color = GC_WHITE;
+            gc->sweep = &object->next;
+            continue;
+        }
+
+        *gc->sweep = object->next;
+        if(object->type == OBJ_STRING) table_delete(&heap->strings, (ObjString*)object);
+        size_t before = heap->bytes_allocated;
+        free_object(heap, object);
+        gc->stats.bytes_freed += before - heap->bytes_allocated;
+    }
+    return work;
+}
+
+
+static void end_cycle(Heap *heap) {
+    Collector *gc = &heap->gc;
+    gc->phase = GC_IDLE;
+    gc->sweep = NULL;
+    gc->stats.cycles += 1;
+    size_t threshold = (size_t)(heap->bytes_allocated * gc_options.growth_factor);
+    gc->next_step = threshold > GC_MIN_HEAP ? threshold : GC_MIN_HEAP;
+}
+
+
+/* Runs one slice of a collection, starting one if none is
+ * under way: gc_options.step_work objects and root values,
+ * or the whole collection when that is 0. Called by the VM
+ * once bytes_allocated passes next_step, at an instruction
+ * where roots describes every live value.
+ */
+void collect_step(Heap *heap, const Roots *roots) {
+    Collector *gc = &heap->gc;
+    uint64_t start = now_ns();
+    size_t budget = gc_options.step_work > 0 ? gc_options.step_work : SIZE_MAX;
+    if(gc->phase == GC_IDLE) begin_cycle(heap);
+
+    size_t work = 0;
+    while(work < budget && gc->phase != GC_IDLE) {
+        if(gc->phase == GC_MARK) {
+            work += mark_roots(heap, roots, budget - work);
+            work += trace_gray(heap, budget - work);
+            if(roots_marked(heap, roots)) work += finish_marking(heap, roots);
+        } else {
+            work += sweep(heap, budget - work);
+            if(*gc->sweep == NULL) end_cycle(heap);
+        }
+    }
+    if(gc->phase != GC_IDLE) gc->next_step = heap->bytes_allocated + GC_STEP_SIZE;
+
+    uint64_t pause = now_ns() - start;
+    gc->stats.steps += 1;
+    gc->stats.pause_total_ns += pause;
+    if(pause > gc->stats.pause_max_ns) gc->stats.pause_max_ns = pause;
+}
+
+
+void print_gc_stats(Heap *heap, FILE *out) {
+    GcStats *stats = &heap->gc.stats;
+    double elapsed_ms = (now_ns() - stats->started_ns) / 1e6;
+    double pause_ms = stats->pause_total_ns / 1e6;
+    fprintf(out, "gc: %llu collection(s) in %llu step(s), pause max %.3f ms, mean %.3f ms, "
+        "total %.3f ms (%.1f%% of %.3f ms)\n", (unsigned long long)stats->cycles,
+        (unsigned long long)stats->steps, stats->pause_max_ns / 1e6,
+        stats->steps > 0 ? pause_ms / stats->steps : 0.0, pause_ms,
+        elapsed_ms > 0 ? 100.0 * pause_ms / elapsed_ms : 0.0, elapsed_ms);
+    fprintf(out, "gc: %.1f KiB allocated, %.1f KiB freed, %.1f KiB live, peak %.1f KiB, "
+        "%.1f MiB/s allocated\n", stats->bytes_allocated / 1024.0, stats->bytes_freed / 1024.0,
+        heap->bytes_allocated / 1024.0, stats->peak_bytes / 1024.0,
+        elapsed_ms > 0 ? stats->bytes_allocated / 1048576.0 / (elapsed_ms / 1e3) : 0.0);
+}
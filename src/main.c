@@ -1,9 +1,29 @@
 
+#include <string.h>
 #include "common.h"
+#include "cache.h"
+#include "runner.h"
+#include "source.h"
 #include "vm.h"
+#include "regvm.h"
 
+/* Execution engine for the REPL and scripts; the register
+ * VM is selected with --registers.
+ */
+static InterpretResult (*interpret_source)(VM *vm, const char *source, size_t length) = interpret;
 
-static void repl() {
+/* Script files run by the stack VM reuse compiled bytecode
+ * from "<path>c" unless --no-cache is given.
+ */
+static bool use_cache = true;
+
+/* --repeat=N runs a script N times in one process, for
+ * timing builds and training PGO without process startup.
+ */
+static int repeat = 1;
+
+
+static void repl(VM *vm) {
     char line[1024];
     for(;;) {
         printf("> ");
@@ -13,47 +33,56 @@ static void repl() {
             break;
         }
 
-        interpret(line);
+        interpret_source(vm, line, strlen(line));
     }
 }
 
 
-static char *read_file(const char *path) {
-    FILE *file = fopen(path, "rb");
-    if(file == NULL) {
-        fprintf(stderr, "Could not open file \"%s\".\n", path);
-        exit(74);
+/* Returns the process exit status for the script. Under -j
+ * this runs on worker threads, so it reports through vm.
+ */
+static int run_file(VM *vm, const char *path) {
+    Source source;
+    if(!open_source(&source, path)) {
+        fprintf(vm->errors, "Could not open file \"%s\".\n", path);
+        return 74;
     }
 
-    fseek(file, 0L, SEEK_END);
-    size_t file_size = ftell(file);
-    rewind(file);
-
-    char *buffer = (char*) malloc(file_size + 1);
-    if(buffer == NULL) {
-        fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
-        exit(74);
+    // Streamed sources have no file to keep a cache next to.
+    char *cache_path = NULL;
+    if(use_cache && interpret_source == interpret && source.mapping != NULL) {
+        size_t path_length = strlen(path);
+        cache_path = malloc(path_length + 2);
+        memcpy(cache_path, path, path_length);
+        memcpy(cache_path + path_length, "c", 2);
     }
 
-    size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
-    if(bytes_read < file_size) {
-        fprintf(stderr, "Could not read file \"%s\".\n", path);
-        exit(74);
+    InterpretResult result = INTERPRET_OK;
+    for(int run = 0; run < repeat && result == INTERPRET_OK; run++) {
+        // Each run, and each script a worker VM picks up, starts
+        // with no globals.
+        reset_globals(vm);
+        if(cache_path != NULL) {
+            result = interpret_cached(vm, source.text, source.length, cache_path);
+        } else {
+            result = interpret_source(vm, source.text, source.length);
+        }
     }
-    buffer[bytes_read] = '\0';
+    free(cache_path);
+    close_source(&source);
 
-    fclose(file);
-    return buffer;
+    if(result == INTERPRET_COMPILE_ERROR) return 65;
+    if(result == INTERPRET_RUNTIME_ERROR) return 70;
+    return 0;
 }
 
 
-static void run_file(const char *path) {
-    char *source = read_file(path);
-    InterpretResult result = interpret(source);
-    free(source);
-
-    if(result == INTERPRET_COMPILE_ERROR) exit(65);
-    if(result == INTERPRET_RUNTIME_ERROR) exit(70);
+static void write_profile(Profile *profile, const char *path) {
+    FILE *file = fopen(path, "w");
+    if(file == NULL || !write_profile_json(profile, file)) {
+        fprintf(stderr, "Could not write profile \"%s\".\n", path);
+    }
+    if(file != NULL) fclose(file);
 }
 
 
@@ -64,18 +93,82 @@ int main(int argc, const char* argv[])
 {
     setbuf(stdout, NULL);
     setbuf(stderr, NULL);
-    init_vm();
+    VM vm;
+    init_vm(&vm);
+
+    bool arena_stats = false;
+    bool gc_stats = false;
+    const char *profile_path = NULL;
+    static Profile profile;
+    int jobs = 0;
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+        if(strcmp(argv[arg], "--registers") == 0) {
+            interpret_source = interpret_registers;
+        } else if(strcmp(argv[arg], "--no-cache") == 0) {
+            use_cache = false;
+        } else if(strncmp(argv[arg], "--repeat=", 9) == 0) {
+            repeat = atoi(argv[arg] + 9);
+        } else if(strcmp(argv[arg], "--arena-stats") == 0) {
+            arena_stats = true;
+        } else if(strcmp(argv[arg], "--gc-stats") == 0) {
+            gc_stats = true;
+        } else if(strncmp(argv[arg], "--gc-growth=", 12) == 0) {
+            gc_options.growth_factor = atof(argv[arg] + 12);
+            if(gc_options.growth_factor < 1) {
+                fprintf(stderr, "--gc-growth needs a factor of at least 1.\n");
+                exit(64);
+            }
+        } else if(strcmp(argv[arg], "--trace") == 0) {
+            debug_options.trace_execution = true;
+        } else if(strcmp(argv[arg], "--print-code") == 0) {
+            debug_options.print_code = true;
+        } else if(strncmp(argv[arg], "--profile=", 10) == 0) {
+            profile_path = argv[arg] + 10;
+            init_profile(&profile);
+            set_vm_profile(&vm, &profile);
+        } else if(strncmp(argv[arg], "-j", 2) == 0) {
+            // -j N or -jN
+            const char *count = argv[arg] + 2;
+            if(*count == '\0' && arg + 1 < argc) count = argv[++arg];
+            jobs = atoi(count);
+            if(jobs < 1) {
+                fprintf(stderr, "-j needs a thread count of at least 1.\n");
+                exit(64);
+            }
+        } else {
+            fprintf(stderr, "Unknown option \"%s\".\n", argv[arg]);
+            exit(64);
+        }
+    }
 
-    if(argc == 1) {
-        repl();
-    } else if (argc == 2) {
-        run_file(argv[1]);
+    // Worker VMs have no profile, and traces would interleave.
+    if(jobs > 0 && (debug_options.trace_execution || debug_options.print_code ||
+        profile_path != NULL || arena_stats || gc_stats)) {
+        fprintf(stderr, "-j cannot be combined with --trace, --print-code, "
+            "--profile, --arena-stats or --gc-stats.\n");
+        exit(64);
+    }
+
+    int status = 0;
+    if(jobs > 0 && argc > arg) {
+        status = run_scripts(argv + arg, argc - arg, jobs, run_file);
+    } else if(argc == arg && jobs == 0) {
+        repl(&vm);
+    } else if (argc == arg + 1) {
+        status = run_file(&vm, argv[arg]);
     } else {
-        fprintf(stderr, "Usage: grino [path]\n");
+        fprintf(stderr, "Usage: grino [--registers] [--trace] [--print-code] "
+            "[--profile=FILE] [--arena-stats] [--gc-stats] [--gc-growth=F] [--no-cache] "
+            "[--repeat=N] [path | -]\n"
+            "       grino -j N [--registers] [--no-cache] [--repeat=N] [--gc-growth=F] path...\n");
         exit(64);
     }
 
-    free_vm();
-    return 0;
+    if(arena_stats) print_vm_arena_report(&vm, stderr);
+    if(gc_stats) print_gc_stats(&vm.heap, stderr);
+    if(profile_path != NULL) write_profile(&profile, profile_path);
+    free_vm(&vm);
+    return status;
 }
 
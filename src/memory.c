@@ -1,11 +1,11 @@
 #include "memory.h"
 
 void *reallocate(void *pointer, size_t old_size, size_t new_size) {
-    if(pointer == NULL) return malloc(new_size);
     if (new_size == 0) {
         free(pointer);
         return NULL;
     }
+    if(pointer == NULL) return malloc(new_size);
 
     void *result = realloc(pointer, new_size);
     if (result == NULL) exit(1);
@@ -0,0 +1,187 @@
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "number.h"
+#include "pow5.h"
+
+#define MAX_DIGITS 19 // decimal digits that always fit a uint64_t
+#define MANTISSA_BITS 52
+#define EXPONENT_BIAS 1023
+#define INFINITE_POWER 0x7FF
+
+/* Exponents of 10 that are exact as doubles, for the
+ * Clinger fast path.
+ */
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+
+/* Slow path: strtod() on a NUL-terminated copy of the token,
+ * which may not be terminated in the source buffer.
+ */
+double parse_number_strtod(const char *start, size_t length) {
+    char digits[64];
+    char *text = length < sizeof(digits) ? digits : reallocate(NULL, 0, length + 1);
+    memcpy(text, start, length);
+    text[length] = '\0';
+    double value = strtod(text, NULL);
+    if(text != digits) reallocate(text, length + 1, 0);
+    return value;
+}
+
+
+#ifdef __SIZEOF_INT128__
+static double make_double(uint64_t mantissa, int power2) {
+    uint64_t bits = mantissa | ((uint64_t)power2 << MANTISSA_BITS);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+/* Eisel-Lemire: w * 10^q rounded to the nearest double using
+ * the 128-bit significand of 5^q. Returns false in the rare
+ * cases where the truncated product cannot decide the
+ * rounding. w must be non-zero.
+ */
+static bool eisel_lemire(uint64_t w, int q, double *value) {
+    if(q < SMALLEST_POWER_OF_FIVE) {
+        *value = 0;
+        return true;
+    }
+    if(q > LARGEST_POWER_OF_FIVE) {
+        *value = make_double(0, INFINITE_POWER);
+        return true;
+    }
+
+    int leading_zeros = __builtin_clzll(w);
+    w <<= leading_zeros;
+
+    // Only the top 55 bits of the product are needed; the low
+    // word of 5^q is consulted when they may carry.
+    const uint64_t *power = &power_of_five_128[2 * (q - SMALLEST_POWER_OF_FIVE)];
+    unsigned __int128 first = (unsigned __int128)w * power[0];
+    uint64_t high = (uint64_t)(first >> 64);
+    uint64_t low = (uint64_t)first;
+    if((high & 0x1FF) == 0x1FF) {
+        uint64_t second = (uint64_t)(((unsigned __int128)w * power[1]) >> 64);
+        low += second;
+        if(second > low) high += 1;
+    }
+    if(low == UINT64_MAX && (q < -27 || q > 55)) return false;
+
+    int upper_bit = (int)(high >> 63);
+    int shift = upper_bit + 64 - MANTISSA_BITS - 3;
+    uint64_t mantissa = high >> shift;
+    // floor(q * log2(10)) + 63, plus the normalization.
+    int power2 = (((152170 + 65536) * q) >> 16) + 63 + upper_bit
+        - leading_zeros + EXPONENT_BIAS;
+
+    if(power2 <= 0) { // subnormal or zero
+        if(-power2 + 1 >= 64) {
+            *value = 0;
+            return true;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        // Rounding up may have reached the smallest normal.
+        power2 = mantissa < ((uint64_t)1 << MANTISSA_BITS) ? 0 : 1;
+        *value = make_double(mantissa & ~((uint64_t)1 << MANTISSA_BITS), power2);
+        return true;
+    }
+
+    // An exact tie (only dropped zero bits) rounds to even.
+    if(low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+        (mantissa << shift) == high) {
+        mantissa &= ~(uint64_t)1;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if(mantissa >= ((uint64_t)2 << MANTISSA_BITS)) {
+        mantissa = (uint64_t)1 << MANTISSA_BITS;
+        power2 += 1;
+    }
+    mantissa &= ~((uint64_t)1 << MANTISSA_BITS);
+    if(power2 >= INFINITE_POWER) {
+        power2 = INFINITE_POWER;
+        mantissa = 0;
+    }
+    *value = make_double(mantissa, power2);
+    return true;
+}
+#endif
+
+
+bool parse_integer(const char *start, size_t length, int64_t *value) {
+    uint64_t w = 0;
+    for(const char *p = start; p < start + length; p++) {
+        if(*p == '.') return false;
+        int digit = *p - '0';
+        if(w > (INT64_MAX - digit) / 10) return false;
+        w = w * 10 + digit;
+    }
+    *value = (int64_t)w;
+    return true;
+}
+
+
+/* The scanner already delimited the token, so the digits are
+ * read once into a 64-bit significand w and an exponent q
+ * (value = w * 10^q). Digits past the 19th are dropped and
+ * only mark the significand as truncated.
+ */
+double parse_number(const char *start, size_t length) {
+    const char *end = start + length;
+    uint64_t w = 0;
+    int q = 0;
+    int digits = 0;
+    bool fraction = false;
+    bool truncated = false;
+    for(const char *p = start; p < end; p++) {
+        if(*p == '.') {
+            fraction = true;
+            continue;
+        }
+        int digit = *p - '0';
+        if(digits < MAX_DIGITS) {
+            if(w == 0 && digit == 0) { // leading zero
+                if(fraction) q -= 1;
+                continue;
+            }
+            w = w * 10 + digit;
+            digits += 1;
+            if(fraction) q -= 1;
+        } else {
+            if(digit != 0) truncated = true;
+            if(!fraction) q += 1;
+        }
+    }
+
+    if(w == 0) return 0;
+    // Integer conversion rounds correctly by itself.
+    if(q == 0 && !truncated) return (double)w;
+
+#if FLT_EVAL_METHOD == 0
+    // Clinger: both operands are exact, so one operation rounds.
+    if(!truncated && w <= ((uint64_t)1 << 53) && q >= -22 && q <= 22) {
+        return q < 0 ? (double)w / exact_powers_of_ten[-q] :
+            (double)w * exact_powers_of_ten[q];
+    }
+#endif
+
+#ifdef __SIZEOF_INT128__
+    double value;
+    if(eisel_lemire(w, q, &value)) {
+        // A truncated significand lies between w and w + 1.
+        double upper;
+        if(!truncated || (eisel_lemire(w + 1, q, &upper) && upper == value)) {
+            return value;
+        }
+    }
+#endif
+    return parse_number_strtod(start, length);
+}
@@ -0,0 +1,145 @@
+#include <string.h>
+#include "memory.h"
+#include "object.h"
+
+
+void init_heap(Heap *heap) {
+    heap->objects = NULL;
+    init_table(&heap->strings);
+    heap->program_strings = NULL;
+    heap->bytes_allocated = 0;
+    heap->permanent = false;
+    init_collector(&heap->gc);
+}
+
+
+void free_object(Heap *heap, Obj *object) {
+    switch(object->type) {
+        case OBJ_STRING: {
+            ObjString *string = (ObjString*)object;
+            size_t size = sizeof(ObjString) + string->length + 1;
+            heap->bytes_allocated -= size;
+            reallocate(object, size, 0);
+            break;
+        }
+    }
+}
+
+
+void free_heap(Heap *heap) {
+    Obj *object = heap->objects;
+    while(object != NULL) {
+        Obj *next = object->next;
+        free_object(heap, object);
+        object = next;
+    }
+    free_table(&heap->strings);
+    free_collector(&heap->gc);
+    init_heap(heap);
+}
+
+
+static Obj *allocate_object(Heap *heap, size_t size, ObjType type) {
+    Obj *object = reallocate(NULL, 0, size);
+    object->type = type;
+    // Black while a collection runs, so it survives that one.
+    object->color = heap->permanent ? GC_PERMANENT :
+        heap->gc.phase == GC_IDLE ? GC_WHITE : GC_BLACK;
+    object->next = heap->objects;
+    heap->objects = object;
+    heap->bytes_allocated += size;
+    heap->gc.stats.bytes_allocated += size;
+    if(heap->bytes_allocated > heap->gc.stats.peak_bytes) {
+        heap->gc.stats.peak_bytes = heap->bytes_allocated;
+    }
+    return object;
+}
+
+
+/* 32-bit FNV-1a, continued from hash. Starting from
+ * EMPTY_STRING_HASH gives the hash of chars alone, and
+ * continuing from a string's hash gives the hash of the
+ * concatenation.
+ */
+uint32_t hash_string(uint32_t hash, const char *chars, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/* Allocates a string of length characters, leaving them to
+ * the caller, and interns it.
+ */
+static ObjString *allocate_string(Heap *heap, size_t length, uint32_t hash) {
+    ObjString *string = (ObjString*)allocate_object(heap,
+        sizeof(ObjString) + length + 1, OBJ_STRING);
+    string->length = (uint32_t)length;
+    string->hash = hash;
+    string->chars[length] = '\0';
+    table_set(&heap->strings, string, NULL_VAL);
+    return string;
+}
+
+
+/* A string found in the intern table while a collection
+ * runs may be one the collection has not reached, so it is
+ * marked before anything can hold on to it.
+ */
+static ObjString *found_string(Heap *heap, ObjString *string) {
+    if(string != NULL && heap->gc.phase != GC_IDLE) mark_object(heap, &string->obj);
+    return string;
+}
+
+
+static ObjString *find_string(Heap *heap, const char *chars, size_t length, uint32_t hash) {
+    ObjString *interned = NULL;
+    if(heap->program_strings != NULL) {
+        interned = table_find_string(heap->program_strings, chars, length, hash);
+    }
+    if(interned == NULL) interned = table_find_string(&heap->strings, chars, length, hash);
+    return found_string(heap, interned);
+}
+
+
+ObjString *copy_string(Heap *heap, const char *chars, size_t length) {
+    uint32_t hash = hash_string(EMPTY_STRING_HASH, chars, length);
+    ObjString *interned = find_string(heap, chars, length, hash);
+    if(interned != NULL) return interned;
+
+    ObjString *string = allocate_string(heap, length, hash);
+    memcpy(string->chars, chars, length);
+    return string;
+}
+
+
+/* Looks the result up before building it, so an existing
+ * string costs no allocation and a new one costs one.
+ */
+ObjString *concatenate_strings(Heap *heap, ObjString *a, ObjString *b) {
+    if(b->length == 0) return a;
+    if(a->length == 0) return b;
+    uint32_t hash = hash_string(a->hash, b->chars, b->length);
+    ObjString *interned = NULL;
+    if(heap->program_strings != NULL) {
+        interned = table_find_concatenation(heap->program_strings, a, b, hash);
+    }
+    if(interned == NULL) interned = table_find_concatenation(&heap->strings, a, b, hash);
+    if(interned != NULL) return found_string(heap, interned);
+
+    ObjString *string = allocate_string(heap, (size_t)a->length + b->length, hash);
+    memcpy(string->chars, a->chars, a->length);
+    memcpy(string->chars + a->length, b->chars, b->length);
+    return string;
+}
+
+
+void print_object(FILE *out, Value value) {
+    switch(OBJ_TYPE(value)) {
+        case OBJ_STRING:
+            fwrite(AS_CSTRING(value), 1, AS_STRING(value)->length, out);
+            break;
+    }
+}
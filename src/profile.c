@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include "debug.h"
+#include "profile.h"
+
+typedef struct {
+    int first;
+    int second;
+    uint64_t count;
+} PairCount;
+
+void init_profile(Profile *profile) {
+    profile->instructions = 0;
+    for(int i = 0; i < OP_COUNT; i++) {
+        profile->opcodes[i] = 0;
+        for(int j = 0; j < OP_COUNT; j++) profile->pairs[i][j] = 0;
+    }
+    profile->previous = -1;
+}
+
+
+/* Pairs are only counted within one run of a chunk. */
+void profile_start_run(Profile *profile) {
+    profile->previous = -1;
+}
+
+
+void profile_instruction(Profile *profile, uint8_t opcode) {
+    profile->instructions += 1;
+    profile->opcodes[opcode] += 1;
+    if(profile->previous >= 0) profile->pairs[profile->previous][opcode] += 1;
+    profile->previous = opcode;
+}
+
+
+static int compare_pairs(const void *a, const void *b) {
+    const PairCount *left = a;
+    const PairCount *right = b;
+    if(left->count != right->count) return left->count < right->count ? 1 : -1;
+    if(left->first != right->first) return left->first - right->first;
+    return left->second - right->second;
+}
+
+
+/* Writes opcode counts and every observed pair, most
+ * frequent first. Returns false on a write error.
+ */
+bool write_profile_json(Profile *profile, FILE *out) {
+    PairCount pairs[OP_COUNT * OP_COUNT];
+    int pair_count = 0;
+    for(int i = 0; i < OP_COUNT; i++) {
+        for(int j = 0; j < OP_COUNT; j++) {
+            if(profile->pairs[i][j] == 0) continue;
+            pairs[pair_count].first = i;
+            pairs[pair_count].second = j;
+            pairs[pair_count].count = profile->pairs[i][j];
+            pair_count += 1;
+        }
+    }
+    qsort(pairs, pair_count, sizeof(PairCount), compare_pairs);
+
+    fprintf(out, "{\n  \"instructions\": %llu,\n  \"opcodes\": {",
+        (unsigned long long)profile->instructions);
+    bool first = true;
+    for(int i = 0; i < OP_COUNT; i++) {
+        if(profile->opcodes[i] == 0) continue;
+        fprintf(out, "%s\n    \"%s\": %llu", first ? "" : ",", opcode_name(i),
+            (unsigned long long)profile->opcodes[i]);
+        first = false;
+    }
+    fprintf(out, "\n  },\n  \"pairs\": [");
+    for(int i = 0; i < pair_count; i++) {
+        fprintf(out, "%s\n    {\"first\": \"%s\", \"second\": \"%s\", \"count\": %llu}",
+            i == 0 ? "" : ",", opcode_name(pairs[i].first), opcode_name(pairs[i].second),
+            (unsigned long long)pairs[i].count);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    return !ferror(out);
+}
@@ -0,0 +1,44 @@
+#include "program.h"
+#include "compiler.h"
+#include "memory.h"
+
+/* Compiles source into a new program, or reports to errors
+ * and returns NULL. The chunk is allocated outside any VM
+ * arena, so it outlives the VMs that run it.
+ */
+Program *compile_program(const char *source, size_t length, FILE *errors) {
+    Program *program = reallocate(NULL, 0, sizeof(Program));
+    init_chunk(&program->chunk);
+    init_heap(&program->heap);
+    program->heap.permanent = true;
+    init_table(&program->globals);
+    if(!compile(source, length, &program->chunk, &program->heap, &program->globals, errors)) {
+        free_program(program);
+        return NULL;
+    }
+    return program;
+}
+
+
+void free_program(Program *program) {
+    free_chunk(&program->chunk);
+    free_table(&program->globals);
+    free_heap(&program->heap);
+    reallocate(program, sizeof(Program), 0);
+}
+
+
+/* Runs program on vm and stores the value it returns in
+ * result; nothing is printed. Runtime errors still go to
+ * vm->errors. Every run starts with no globals defined, so
+ * it also forgets those of earlier interpret() calls.
+ */
+InterpretResult run_program(VM *vm, Program *program, Value *result) {
+    reset_globals(vm);
+    vm->heap.program_strings = &program->heap.strings;
+    vm->running_names = &program->globals;
+    InterpretResult status = run_chunk(vm, &program->chunk, result);
+    vm->running_names = &vm->global_names;
+    vm->heap.program_strings = NULL;
+    return status;
+}
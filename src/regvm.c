@@ -0,0 +1,371 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include "regvm.h"
+#include "compiler.h"
+#include "debug.h"
+
+/* Alternative execution engine for register bytecode.
+ * Operands are read straight from the register file or the
+ * constant pool, so an expression costs one dispatch per
+ * operator and no stack traffic.
+ */
+typedef struct {
+    VM *vm; // owner of the globals
+    RegisterChunk *chunk;
+    uint8_t *ip;
+    Value *registers;
+    Heap *heap;
+    FILE *errors;
+} RegisterVM;
+
+static InterpretResult run(RegisterVM *rvm, Value *result);
+static void runtime_error(RegisterVM *rvm, const char* format, ...);
+static void undefined_variable(RegisterVM *rvm, int slot);
+static void trace_instruction(RegisterVM *rvm);
+static void step_collector(RegisterVM *rvm);
+
+void init_register_chunk(RegisterChunk *chunk) {
+    init_chunk(&chunk->chunk);
+    chunk->register_count = 0;
+}
+
+
+void free_register_chunk(RegisterChunk *chunk) {
+    free_chunk(&chunk->chunk);
+    chunk->register_count = 0;
+}
+
+
+int register_instruction_length(uint8_t instruction) {
+    switch(instruction) {
+        case ROP_RETURN: return 3;
+        case ROP_NEGATE:
+        case ROP_NOT:
+        case ROP_MOVE:
+        case ROP_GET_GLOBAL:
+        case ROP_DEFINE_GLOBAL:
+        case ROP_SET_GLOBAL: return 5;
+        default: return 7;
+    }
+}
+
+
+/* Register counterpart of interpret(). Only the output
+ * streams and the heap of vm are used.
+ */
+InterpretResult interpret_registers(VM *vm, const char *source, size_t length) {
+    RegisterChunk chunk;
+    init_register_chunk(&chunk);
+    if(!compile_registers(source, length, &chunk, &vm->heap, &vm->global_names, vm->errors)) {
+        free_register_chunk(&chunk);
+        return INTERPRET_COMPILE_ERROR;
+    }
+
+    InterpretResult result = run_register_chunk(vm, &chunk);
+    free_register_chunk(&chunk);
+    return result;
+}
+
+
+InterpretResult run_register_chunk(VM *vm, RegisterChunk *chunk) {
+    RegisterVM rvm;
+    rvm.vm = vm;
+    rvm.chunk = chunk;
+    rvm.ip = chunk->chunk.code;
+    rvm.heap = &vm->heap;
+    rvm.errors = vm->errors;
+    int size = chunk->register_count > 0 ? chunk->register_count : 1;
+    rvm.registers = reallocate(NULL, 0, size * sizeof(Value));
+    // The collector marks every register, so none may hold garbage.
+    for(int i = 0; i < size; i++) rvm.registers[i] = NULL_VAL;
+    restart_constant_scan(rvm.heap);
+    reserve_globals(vm, chunk->chunk.global_count);
+
+    Value value;
+    InterpretResult result = run(&rvm, &value);
+    reallocate(rvm.registers, size * sizeof(Value), 0);
+    if(result == INTERPRET_OK) {
+        print_value(vm->out, value);
+        fputc('\n', vm->out);
+    }
+    return result;
+}
+
+
+#define READ_OPERAND() (rvm->ip += 2, (uint16_t)((rvm->ip[-2] << 8) | rvm->ip[-1]))
+#define READ_RK() read_rk(rvm, registers, constants)
+
+/* The same integer paths as the stack VM's handlers. */
+#define REGISTER_COMPARISON_OP(op) \
+    do { \
+        Value *dst = &registers[READ_OPERAND()]; \
+        Value b = READ_RK(); \
+        Value c = READ_RK(); \
+        if(IS_INT(b) && IS_INT(c)) { \
+            *dst = BOOL_VAL(AS_INT(b) op AS_INT(c)); \
+            break; \
+        } \
+        if(!IS_NUMBER(b) || !IS_NUMBER(c)) { \
+            runtime_error(rvm, "Operands must be numbers."); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+        *dst = BOOL_VAL(AS_NUMBER(b) op AS_NUMBER(c)); \
+    } while(false)
+
+#define REGISTER_ARITHMETIC_OP(int_op, op) \
+    do { \
+        Value *dst = &registers[READ_OPERAND()]; \
+        Value b = READ_RK(); \
+        Value c = READ_RK(); \
+        int64_t value; \
+        if(IS_INT(b) && IS_INT(c) && int_op(AS_INT(b), AS_INT(c), &value)) { \
+            *dst = INT_VAL(value); \
+            break; \
+        } \
+        if(!IS_NUMBER(b) || !IS_NUMBER(c)) { \
+            runtime_error(rvm, "Operands must be numbers."); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+        *dst = NUMBER_VAL(AS_NUMBER(b) op AS_NUMBER(c)); \
+    } while(false)
+
+/* Same as the stack VM: a store into a slot the collector
+ * may have marked already marks the value.
+ */
+#define WRITE_GLOBAL(slot, value) \
+    do { \
+        if(rvm->heap->gc.phase == GC_MARK) mark_value(rvm->heap, value); \
+        rvm->vm->globals[slot] = (value); \
+    } while(false)
+
+/* Tracing works as in the stack VM's run(): with
+ * COMPUTED_GOTO, run() dispatches through hook_table while
+ * tracing, whose entries all lead to trace_instruction() and
+ * then to the real handler, so the handlers check nothing.
+ * The switch loop tests a local flag instead.
+ */
+#ifdef COMPUTED_GOTO
+#define DISPATCH_LOOP       DISPATCH();
+#define CASE(op)            do_##op:
+#define DISPATCH()          goto *dispatch[*rvm->ip++]
+#else
+#define DISPATCH_LOOP \
+    for(;;) switch(traced ? (trace_instruction(rvm), *rvm->ip++) : *rvm->ip++)
+#define CASE(op)            case op:
+#define DISPATCH()          break
+#endif
+
+
+static inline Value read_rk(RegisterVM *rvm, Value *registers, Value *constants) {
+    uint16_t operand = READ_OPERAND();
+    if(operand & RK_CONSTANT) return constants[operand & MAX_REGISTER_OPERAND];
+    return registers[operand];
+}
+
+
+static InterpretResult run(RegisterVM *rvm, Value *result) {
+    #ifdef COMPUTED_GOTO
+    static void *dispatch_table[] = {
+        [ROP_RETURN]        = &&do_ROP_RETURN,
+        [ROP_NEGATE]        = &&do_ROP_NEGATE,
+        [ROP_NOT]           = &&do_ROP_NOT,
+        [ROP_ADD]           = &&do_ROP_ADD,
+        [ROP_SUBTRACT]      = &&do_ROP_SUBTRACT,
+        [ROP_MULTIPLY]      = &&do_ROP_MULTIPLY,
+        [ROP_DIVIDE]        = &&do_ROP_DIVIDE,
+        [ROP_EQUAL]         = &&do_ROP_EQUAL,
+        [ROP_NOT_EQUAL]     = &&do_ROP_NOT_EQUAL,
+        [ROP_GREATER]       = &&do_ROP_GREATER,
+        [ROP_LESS]          = &&do_ROP_LESS,
+        [ROP_GREATER_EQUAL] = &&do_ROP_GREATER_EQUAL,
+        [ROP_LESS_EQUAL]    = &&do_ROP_LESS_EQUAL,
+        [ROP_MOVE]          = &&do_ROP_MOVE,
+        [ROP_GET_GLOBAL]    = &&do_ROP_GET_GLOBAL,
+        [ROP_DEFINE_GLOBAL] = &&do_ROP_DEFINE_GLOBAL,
+        [ROP_SET_GLOBAL]    = &&do_ROP_SET_GLOBAL,
+    };
+    // Neither table is ever written, so VMs on other threads share them.
+    static void *hook_table[] = {[0 ... ROP_COUNT - 1] = &&do_hook};
+    void **dispatch = debug_options.trace_execution ? hook_table : dispatch_table;
+    #else
+    bool traced = debug_options.trace_execution;
+    #endif
+
+    Value *registers = rvm->registers;
+    Value *constants = rvm->chunk->chunk.constants.values;
+
+    DISPATCH_LOOP {
+        #ifdef COMPUTED_GOTO
+        do_hook: {
+            rvm->ip -= 1;
+            trace_instruction(rvm);
+            goto *dispatch_table[*rvm->ip++];
+        }
+        #endif
+        CASE(ROP_NEGATE) {
+            Value *dst = &registers[READ_OPERAND()];
+            Value operand = READ_RK();
+            if(!IS_NUMBER(operand)) {
+                runtime_error(rvm, "Operand must be a number.");
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            int64_t negated;
+            if(IS_INT(operand) && int_negate(AS_INT(operand), &negated)) {
+                *dst = INT_VAL(negated);
+            } else {
+                *dst = NUMBER_VAL(-AS_NUMBER(operand));
+            }
+            DISPATCH();
+        }
+        CASE(ROP_NOT) {
+            Value *dst = &registers[READ_OPERAND()];
+            *dst = BOOL_VAL(is_falsey(READ_RK()));
+            DISPATCH();
+        }
+        CASE(ROP_ADD) {
+            Value *dst = &registers[READ_OPERAND()];
+            Value b = READ_RK();
+            Value c = READ_RK();
+            int64_t value;
+            if(IS_INT(b) && IS_INT(c) && int_add(AS_INT(b), AS_INT(c), &value)) {
+                *dst = INT_VAL(value);
+            } else if(IS_NUMBER(b) && IS_NUMBER(c)) {
+                *dst = NUMBER_VAL(AS_NUMBER(b) + AS_NUMBER(c));
+            } else if(IS_STRING(b) && IS_STRING(c)) {
+                // b and c are still in registers or constants, so they stay rooted.
+                if(rvm->heap->bytes_allocated >= rvm->heap->gc.next_step) step_collector(rvm);
+                *dst = OBJ_VAL(concatenate_strings(rvm->heap, AS_STRING(b), AS_STRING(c)));
+            } else {
+                runtime_error(rvm, "Operands must be two numbers or two strings.");
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            DISPATCH();
+        }
+        CASE(ROP_SUBTRACT) {
+            REGISTER_ARITHMETIC_OP(int_subtract, -);
+            DISPATCH();
+        }
+        CASE(ROP_MULTIPLY) {
+            REGISTER_ARITHMETIC_OP(int_multiply, *);
+            DISPATCH();
+        }
+        CASE(ROP_DIVIDE) {
+            REGISTER_ARITHMETIC_OP(int_divide, /);
+            DISPATCH();
+        }
+        CASE(ROP_EQUAL) {
+            Value *dst = &registers[READ_OPERAND()];
+            Value b = READ_RK();
+            Value c = READ_RK();
+            *dst = BOOL_VAL(values_equal(b, c));
+            DISPATCH();
+        }
+        CASE(ROP_NOT_EQUAL) {
+            Value *dst = &registers[READ_OPERAND()];
+            Value b = READ_RK();
+            Value c = READ_RK();
+            *dst = BOOL_VAL(!values_equal(b, c));
+            DISPATCH();
+        }
+        CASE(ROP_GREATER) {
+            REGISTER_COMPARISON_OP(>);
+            DISPATCH();
+        }
+        CASE(ROP_LESS) {
+            REGISTER_COMPARISON_OP(<);
+            DISPATCH();
+        }
+        CASE(ROP_GREATER_EQUAL) {
+            REGISTER_COMPARISON_OP(>=);
+            DISPATCH();
+        }
+        CASE(ROP_LESS_EQUAL) {
+            REGISTER_COMPARISON_OP(<=);
+            DISPATCH();
+        }
+        CASE(ROP_MOVE) {
+            Value *dst = &registers[READ_OPERAND()];
+            *dst = READ_RK();
+            DISPATCH();
+        }
+        CASE(ROP_GET_GLOBAL) {
+            Value *dst = &registers[READ_OPERAND()];
+            uint16_t slot = READ_OPERAND();
+            if(IS_UNDEFINED(rvm->vm->globals[slot])) {
+                undefined_variable(rvm, slot);
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            *dst = rvm->vm->globals[slot];
+            DISPATCH();
+        }
+        CASE(ROP_DEFINE_GLOBAL) {
+            uint16_t slot = READ_OPERAND();
+            WRITE_GLOBAL(slot, READ_RK());
+            DISPATCH();
+        }
+        CASE(ROP_SET_GLOBAL) {
+            uint16_t slot = READ_OPERAND();
+            Value value = READ_RK();
+            if(IS_UNDEFINED(rvm->vm->globals[slot])) {
+                undefined_variable(rvm, slot);
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            WRITE_GLOBAL(slot, value);
+            DISPATCH();
+        }
+        CASE(ROP_RETURN) {
+            *result = READ_RK();
+            return INTERPRET_OK;
+        }
+    }
+    return INTERPRET_RUNTIME_ERROR;
+}
+
+
+/* Takes one slice of a collection of the heap. As in the
+ * stack VM, the globals with their names and the chunk's
+ * constants are roots; the register file takes the place
+ * of the stack, and a register still holding a dead
+ * temporary only keeps its value alive a little longer.
+ */
+static void step_collector(RegisterVM *rvm) {
+    Roots roots;
+    roots.stack = rvm->registers;
+    roots.stack_count = rvm->chunk->register_count;
+    roots.globals = rvm->vm->globals;
+    roots.global_count = rvm->vm->global_capacity;
+    roots.names = &rvm->vm->global_names;
+    roots.constants = &rvm->chunk->chunk.constants;
+    collect_step(rvm->heap, &roots);
+}
+
+
+static void trace_instruction(RegisterVM *rvm) {
+    disassemble_register_instruction(rvm->chunk, (int)(rvm->ip - rvm->chunk->chunk.code));
+}
+
+
+static void runtime_error(RegisterVM *rvm, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(rvm->errors, format, args);
+    va_end(args);
+    fputs("\n", rvm->errors);
+
+    /* Every byte of an instruction carries its line, and the
+       handlers raise errors after reading all operands. */
+    Chunk *chunk = &rvm->chunk->chunk;
+    size_t instruction = rvm->ip - chunk->code - 1;
+    int line = get_line(chunk, instruction);
+    fprintf(rvm->errors, "[line %d] in script\n", line);
+}
+
+
+static void undefined_variable(RegisterVM *rvm, int slot) {
+    ObjString *name = global_name(rvm->vm, slot);
+    if(name != NULL) {
+        runtime_error(rvm, "Undefined variable '%s'.", name->chars);
+    } else {
+        runtime_error(rvm, "Undefined variable.");
+    }
+}
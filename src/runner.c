@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "runner.h"
+
+/* One script of a run_scripts() call. The worker that runs
+ * it collects its output and errors in memory; the calling
+ * thread writes them out once every earlier script has been
+ * written.
+ */
+typedef struct {
+    const char *path;
+    char *output;
+    size_t output_size;
+    char *errors;
+    size_t errors_size;
+    int status;
+    bool done;
+} Script;
+
+typedef struct {
+    Script *scripts;
+    int count;
+    int next; // first script no worker has claimed
+    ScriptRunner run_script;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} Pool;
+
+
+static void run_script_captured(Pool *pool, VM *vm, Script *script) {
+    vm->out = open_memstream(&script->output, &script->output_size);
+    vm->errors = open_memstream(&script->errors, &script->errors_size);
+    if(vm->out == NULL || vm->errors == NULL) {
+        fprintf(stderr, "Could not buffer the output of \"%s\".\n", script->path);
+        script->status = 71;
+    } else {
+        script->status = pool->run_script(vm, script->path);
+    }
+    if(vm->out != NULL) fclose(vm->out);
+    if(vm->errors != NULL) fclose(vm->errors);
+}
+
+
+/* Each worker keeps one VM for all the scripts it claims,
+ * so its stack and compile arena are reused.
+ */
+static void *worker(void *argument) {
+    Pool *pool = argument;
+    VM vm;
+    init_vm(&vm);
+    for(;;) {
+        pthread_mutex_lock(&pool->lock);
+        int index = pool->next < pool->count ? pool->next++ : -1;
+        pthread_mutex_unlock(&pool->lock);
+        if(index < 0) break;
+
+        Script *script = &pool->scripts[index];
+        run_script_captured(pool, &vm, script);
+
+        pthread_mutex_lock(&pool->lock);
+        script->done = true;
+        pthread_cond_broadcast(&pool->finished);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    free_vm(&vm);
+    return NULL;
+}
+
+
+/* Runs count scripts on up to jobs worker threads. Each
+ * script's output goes to stdout and its errors to stderr
+ * in the order the paths were given, as soon as it and all
+ * the scripts before it are finished. Returns the status of
+ * the first script that failed, or 0.
+ */
+int run_scripts(const char **paths, int count, int jobs, ScriptRunner run_script) {
+    Pool pool;
+    pool.scripts = calloc(count, sizeof(Script));
+    pool.count = count;
+    pool.next = 0;
+    pool.run_script = run_script;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.finished, NULL);
+    for(int i = 0; i < count; i++) pool.scripts[i].path = paths[i];
+
+    if(jobs > count) jobs = count;
+    pthread_t *threads = malloc(jobs * sizeof(pthread_t));
+    int started = 0;
+    while(started < jobs && pthread_create(&threads[started], NULL, worker, &pool) == 0) {
+        started += 1;
+    }
+    // Without any worker the calling thread runs them all.
+    if(started == 0) worker(&pool);
+
+    int status = 0;
+    for(int i = 0; i < count; i++) {
+        Script *script = &pool.scripts[i];
+        pthread_mutex_lock(&pool.lock);
+        while(!script->done) pthread_cond_wait(&pool.finished, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+
+        if(script->output != NULL) fwrite(script->output, 1, script->output_size, stdout);
+        if(script->errors != NULL) fwrite(script->errors, 1, script->errors_size, stderr);
+        free(script->output);
+        free(script->errors);
+        if(status == 0) status = script->status;
+    }
+
+    for(int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_cond_destroy(&pool.finished);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.scripts);
+    return status;
+}
@@ -1,75 +1,232 @@
 #include "scanner.h"
 
-static Scanner scanner;
-
-static char advance();
-static bool is_at_end();
-static Token make_token(TokenType type);
-static Token error_token(const char *message);
-static char peek();
-static char peek_next();
-static bool match(char expected);
+/* Slot in the generated keyword table. Empty slots hold a
+ * zero word, which no identifier packs to.
+ */
+typedef struct {
+    uint64_t word;
+    TokenType type;
+} Keyword;
+
+#include "keywords.h"
+
+
+static char advance(Scanner *scanner);
+static bool is_at_end(Scanner *scanner);
+static Token make_token(Scanner *scanner, TokenType type);
+static Token error_token(Scanner *scanner, const char *message);
+static char peek(Scanner *scanner);
+static char peek_next(Scanner *scanner);
+static bool match(Scanner *scanner, char expected);
 static bool is_alpha(char c);
-static Token identifier();
-static TokenType identifier_type();
-static TokenType check_keyword(int start, int length, const char *rest, TokenType type);
+static Token identifier(Scanner *scanner);
+static TokenType identifier_type(Scanner *scanner);
 static bool is_digit(char c);
-static Token number();
-static Token string();
-static void skip_whitespace();
+static Token number(Scanner *scanner);
+static Token string(Scanner *scanner);
+static void skip_whitespace(Scanner *scanner);
+
+
+/* Run scanners. Each returns the first byte at or after p
+ * that ends the run (or end). With SCANNER_SSE2/AVX2 they
+ * classify a block of bytes per step while a whole block
+ * remains and finish with the scalar loop; the line counting
+ * ones add the newlines they pass to *line with popcount.
+ */
+#if defined(SCANNER_AVX2) || defined(SCANNER_SSE2)
+#include <immintrin.h>
+
+#ifdef SCANNER_AVX2
+typedef __m256i Block;
+typedef uint32_t BlockMask;
+#define BLOCK_SIZE      32
+#define LOAD(p)         _mm256_loadu_si256((const __m256i*)(p))
+#define SPLAT(c)        _mm256_set1_epi8(c)
+#define EQ(a, b)        _mm256_cmpeq_epi8(a, b)
+#define GT(a, b)        _mm256_cmpgt_epi8(a, b)
+#define AND(a, b)       _mm256_and_si256(a, b)
+#define OR(a, b)        _mm256_or_si256(a, b)
+#define MASK(v)         ((BlockMask)_mm256_movemask_epi8(v))
+#else
+typedef __m128i Block;
+typedef uint32_t BlockMask;
+#define BLOCK_SIZE      16
+#define LOAD(p)         _mm_loadu_si128((const __m128i*)(p))
+#define SPLAT(c)        _mm_set1_epi8(c)
+#define EQ(a, b)        _mm_cmpeq_epi8(a, b)
+#define GT(a, b)        _mm_cmpgt_epi8(a, b)
+#define AND(a, b)       _mm_and_si128(a, b)
+#define OR(a, b)        _mm_or_si128(a, b)
+#define MASK(v)         ((BlockMask)_mm_movemask_epi8(v))
+#endif
+
+/* Bytes in [low, high]. The compares are signed, so bytes
+ * at or above 0x80 never fall inside an ASCII range.
+ */
+static inline Block in_range(Block c, char low, char high) {
+    return AND(GT(c, SPLAT(low - 1)), GT(SPLAT(high + 1), c));
+}
+
+static inline BlockMask blank_mask(Block c) {
+    return MASK(OR(OR(EQ(c, SPLAT(' ')), EQ(c, SPLAT('\t'))),
+        OR(EQ(c, SPLAT('\r')), EQ(c, SPLAT('\n')))));
+}
+
+static inline BlockMask identifier_mask(Block c) {
+    Block lower = OR(c, SPLAT(0x20));
+    return MASK(OR(OR(in_range(lower, 'a', 'z'), in_range(c, '0', '9')),
+        EQ(c, SPLAT('_'))));
+}
+
+static inline BlockMask digit_mask(Block c) {
+    return MASK(in_range(c, '0', '9'));
+}
+
+/* Newlines before the first n bytes of the block. */
+static inline int count_lines(BlockMask newlines, int n) {
+    return __builtin_popcount(newlines & (BlockMask)((1ULL << n) - 1));
+}
+#endif
+
+
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static inline bool is_identifier_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') || c == '_';
+}
+
+
+static const char *skip_blanks(const char *p, const char *end, int *line) {
+#if defined(SCANNER_AVX2) || defined(SCANNER_SSE2)
+    while(end - p >= BLOCK_SIZE) {
+        Block c = LOAD(p);
+        BlockMask newlines = MASK(EQ(c, SPLAT('\n')));
+        BlockMask other = ~blank_mask(c) & (BlockMask)((1ULL << BLOCK_SIZE) - 1);
+        if(other != 0) {
+            int n = __builtin_ctz(other);
+            *line += count_lines(newlines, n);
+            return p + n;
+        }
+        *line += __builtin_popcount(newlines);
+        p += BLOCK_SIZE;
+    }
+#endif
+    for(; p < end && is_blank(*p); p++) {
+        if(*p == '\n') *line += 1;
+    }
+    return p;
+}
 
 
+static const char *skip_identifier(const char *p, const char *end) {
+#if defined(SCANNER_AVX2) || defined(SCANNER_SSE2)
+    while(end - p >= BLOCK_SIZE) {
+        BlockMask other = ~identifier_mask(LOAD(p)) & (BlockMask)((1ULL << BLOCK_SIZE) - 1);
+        if(other != 0) return p + __builtin_ctz(other);
+        p += BLOCK_SIZE;
+    }
+#endif
+    while(p < end && is_identifier_char(*p)) p++;
+    return p;
+}
+
 
-void init_scanner(const char *source) {
-    scanner.start = source;
-    scanner.current = source;
-    scanner.line = 1;
+static const char *skip_digits(const char *p, const char *end) {
+#if defined(SCANNER_AVX2) || defined(SCANNER_SSE2)
+    while(end - p >= BLOCK_SIZE) {
+        BlockMask other = ~digit_mask(LOAD(p)) & (BlockMask)((1ULL << BLOCK_SIZE) - 1);
+        if(other != 0) return p + __builtin_ctz(other);
+        p += BLOCK_SIZE;
+    }
+#endif
+    while(p < end && *p >= '0' && *p <= '9') p++;
+    return p;
 }
 
 
-static char advance() {
-    scanner.current += 1;
-    return scanner.current[-1];
+/* Finds the next stop byte, counting the newlines before it
+ * unless stop is itself '\n'.
+ */
+static const char *find_byte(const char *p, const char *end, char stop, int *line) {
+#if defined(SCANNER_AVX2) || defined(SCANNER_SSE2)
+    while(end - p >= BLOCK_SIZE) {
+        Block c = LOAD(p);
+        BlockMask found = MASK(EQ(c, SPLAT(stop)));
+        BlockMask newlines = stop == '\n' ? 0 : MASK(EQ(c, SPLAT('\n')));
+        if(found != 0) {
+            int n = __builtin_ctz(found);
+            *line += count_lines(newlines, n);
+            return p + n;
+        }
+        *line += __builtin_popcount(newlines);
+        p += BLOCK_SIZE;
+    }
+#endif
+    for(; p < end && *p != stop; p++) {
+        if(*p == '\n') *line += 1;
+    }
+    return p;
+}
+
+
+
+void init_scanner(Scanner *scanner, const char *source, size_t length) {
+    scanner->start = source;
+    scanner->current = source;
+    scanner->end = source + length;
+    scanner->line = 1;
 }
 
 
-static bool is_at_end() {
-    return *(scanner.current) == '\0';
+static char advance(Scanner *scanner) {
+    scanner->current += 1;
+    return scanner->current[-1];
 }
 
-static Token make_token(TokenType type) {
+
+static bool is_at_end(Scanner *scanner) {
+    return scanner->current >= scanner->end;
+}
+
+static Token make_token(Scanner *scanner, TokenType type) {
     Token token;
     token.type = type;
-    token.start = scanner.start;
-    token.length = (int)(scanner.current - scanner.start);
-    token.line = scanner.line;
+    token.start = scanner->start;
+    token.length = (int)(scanner->current - scanner->start);
+    token.line = scanner->line;
     return token;
 }
 
-static Token error_token(const char *message) {
+static Token error_token(Scanner *scanner, const char *message) {
     Token token;
     token.type = TOKEN_ERROR;
     token.start = message;
     token.length = (int)strlen(message);
-    token.line = scanner.line;
+    token.line = scanner->line;
     return token;
 }
 
-static char peek() {
-    return *(scanner.current);
+/* Reads past the end return '\0', which no token accepts. */
+static char peek(Scanner *scanner) {
+    if(is_at_end(scanner)) return '\0';
+    return *(scanner->current);
 }
 
 
-static char peek_next() {
-    if(is_at_end()) return '\0';
-    return scanner.current[1];
+static char peek_next(Scanner *scanner) {
+    if(scanner->end - scanner->current < 2) return '\0';
+    return scanner->current[1];
 }
 
 
-static bool match(char expected) {
-    if(is_at_end()) return false;
-    if(*(scanner.current) != expected) return false;
-    scanner.current += 1;
+static bool match(Scanner *scanner, char expected) {
+    if(is_at_end(scanner)) return false;
+    if(*(scanner->current) != expected) return false;
+    scanner->current += 1;
     return true;
 }
 
@@ -81,48 +238,48 @@ static bool is_alpha(char c) {
 }
 
 
-static Token identifier() {
-    while(is_alpha(peek()) || is_digit(peek())) advance();
-    return make_token(identifier_type());
+static Token identifier(Scanner *scanner) {
+    scanner->current = skip_identifier(scanner->current, scanner->end);
+    return make_token(scanner, identifier_type(scanner));
 }
 
 
-Token scan_token() {
-    skip_whitespace();
-    scanner.start = scanner.current;
+Token scan_token(Scanner *scanner) {
+    skip_whitespace(scanner);
+    scanner->start = scanner->current;
 
-    if(is_at_end()) { return make_token(TOKEN_EOF); }
+    if(is_at_end(scanner)) { return make_token(scanner, TOKEN_EOF); }
 
-    char c = advance();
+    char c = advance(scanner);
     if(is_alpha(c)) { 
-        return identifier(); }
+        return identifier(scanner); }
     if(is_digit(c)) { 
-        return number(); }
+        return number(scanner); }
     switch(c) {
-        case '(': return make_token(TOKEN_LEFT_PAREN);
-        case ')': return make_token(TOKEN_RIGHT_PAREN);
-        case '{': return make_token(TOKEN_LEFT_BRACE);
-        case '}': return make_token(TOKEN_RIGHT_BRACE);
-        case ';': return make_token(TOKEN_SEMICOLON);
-        case ',': return make_token(TOKEN_COMMA);
-        case '.': return make_token(TOKEN_DOT);
-        case '-': return make_token(TOKEN_MINUS);
-        case '+': return make_token(TOKEN_PLUS);
-        case '/': return make_token(TOKEN_SLASH);
-        case '*': return make_token(TOKEN_STAR);
+        case '(': return make_token(scanner, TOKEN_LEFT_PAREN);
+        case ')': return make_token(scanner, TOKEN_RIGHT_PAREN);
+        case '{': return make_token(scanner, TOKEN_LEFT_BRACE);
+        case '}': return make_token(scanner, TOKEN_RIGHT_BRACE);
+        case ';': return make_token(scanner, TOKEN_SEMICOLON);
+        case ',': return make_token(scanner, TOKEN_COMMA);
+        case '.': return make_token(scanner, TOKEN_DOT);
+        case '-': return make_token(scanner, TOKEN_MINUS);
+        case '+': return make_token(scanner, TOKEN_PLUS);
+        case '/': return make_token(scanner, TOKEN_SLASH);
+        case '*': return make_token(scanner, TOKEN_STAR);
         case '!':
-            if(match('=')) return make_token(TOKEN_BANG_EQUAL); break;
+            if(match(scanner, '=')) return make_token(scanner, TOKEN_BANG_EQUAL); break;
         case '=':
-            return make_token(match('=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL);
+            return make_token(scanner, match(scanner, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL);
         case '<':
-            return make_token(match('=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
+            return make_token(scanner, match(scanner, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
         case '>':
-            return make_token(match('=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER);
-        case '"': return string();
+            return make_token(scanner, match(scanner, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER);
+        case '"': return string(scanner);
 
     }
 
-    return error_token("Unexpected character.");
+    return error_token(scanner, "Unexpected character.");
 }
 
 
@@ -130,50 +287,33 @@ Token scan_token() {
 
 
 
-static TokenType identifier_type() {
-    switch(scanner.start[0]) {
-        case 'a': return check_keyword(1, 2, "nd", TOKEN_AND);
-        case 'c': return check_keyword(1, 4, "lass", TOKEN_CLASS);
-        case 'e': return check_keyword(1, 3, "lse", TOKEN_ELSE);
-        case 'f': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'a': return check_keyword(2, 3, "lse", TOKEN_FALSE);
-                    case 'o': return check_keyword(2, 1, "r", TOKEN_FOR);
-                    case 'u': return check_keyword(2, 1, "n", TOKEN_FUN);
-                }
-            }
-            break;
-        }
-        case 't':
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'h': return check_keyword(2, 2, "is", TOKEN_THIS);
-                    case 'r': return check_keyword(2, 2, "ue", TOKEN_TRUE);
-                }
-            }
-            break;
-        case 'i': return check_keyword(1, 1, "f", TOKEN_IF);
-        case 'n': return check_keyword(1, 2, "ot", TOKEN_BANG);
-        case 'N': return check_keyword(1, 3, "ULL", TOKEN_NULL);
-        case 'o': return check_keyword(1, 1, "r", TOKEN_OR);
-        case 'p': return check_keyword(1, 4, "rint", TOKEN_PRINT);
-        case 'r': return check_keyword(1, 5, "eturn", TOKEN_RETURN);
-        case 's': return check_keyword(1, 4, "uper", TOKEN_SUPER);
-        case 'v': return check_keyword(1, 2, "ar", TOKEN_VAR);
-        case 'w': return check_keyword(1, 4, "hile", TOKEN_WHILE);
+/* Identifier bytes zero-padded to a word, packed the same
+ * way the generator packed the keywords.
+ */
+static inline uint64_t load_word(const char *start, const char *end, size_t length) {
+    uint64_t word = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if(end - start >= (ptrdiff_t)sizeof(word)) {
+        memcpy(&word, start, sizeof(word));
+        return length == sizeof(word) ? word : word & ((1ULL << (length * 8)) - 1);
     }
-
-    return TOKEN_IDENTIFIER;
+#endif
+    memcpy(&word, start, length);
+    return word;
 }
 
-static TokenType check_keyword(int start, int length,
-    const char *rest, TokenType type) {
-        if(scanner.current - scanner.start == start + length &&
-            memcmp(scanner.start + start, rest, length) == 0) {
-                return type;
-            }
-        return TOKEN_IDENTIFIER;
+
+/* One hash, one table load and one word compare; see
+ * include/keywords.def for the keyword list.
+ */
+static TokenType identifier_type(Scanner *scanner) {
+    size_t length = scanner->current - scanner->start;
+    if(length > KEYWORD_MAX_LENGTH) return TOKEN_IDENTIFIER;
+
+    uint64_t word = load_word(scanner->start, scanner->end, length);
+    const Keyword *keyword =
+        &keyword_table[(word * KEYWORD_HASH_MULTIPLIER) >> KEYWORD_HASH_SHIFT];
+    return keyword->word == word ? keyword->type : TOKEN_IDENTIFIER;
 }
 
 
@@ -184,56 +324,35 @@ static bool is_digit(char c) {
 
 
 
-static Token number() {
-    while(is_digit(peek())) advance();
+static Token number(Scanner *scanner) {
+    scanner->current = skip_digits(scanner->current, scanner->end);
 
-    if(peek() == '.' && is_digit(peek_next())) {
-        advance();
+    if(peek(scanner) == '.' && is_digit(peek_next(scanner))) {
+        advance(scanner);
 
-        while(is_digit(peek())) advance();
+        scanner->current = skip_digits(scanner->current, scanner->end);
     }
 
-    return make_token(TOKEN_NUMBER);
+    return make_token(scanner, TOKEN_NUMBER);
 }
 
-static Token string() {
-    while(peek() != '"' && !is_at_end()) {
-        if(peek() == '\n') scanner.line += 1;
-        advance();
-    }
+static Token string(Scanner *scanner) {
+    scanner->current = find_byte(scanner->current, scanner->end, '"', &scanner->line);
 
-    if(is_at_end()) return error_token("Unterminated string.");
+    if(is_at_end(scanner)) return error_token(scanner, "Unterminated string.");
 
-    advance();
-    return make_token(TOKEN_STRING);
+    advance(scanner);
+    return make_token(scanner, TOKEN_STRING);
 }
 
 
-static void skip_whitespace() {
+static void skip_whitespace(Scanner *scanner) {
     for(;;) {
-        char c = peek();
-        switch(c) {
-            case ' ':
-            case '\r':
-            case '\t':
-                advance();
-                break;
-            case '\n':
-                scanner.line += 1;
-                advance();
-                break;
-            case '/':
-                if(peek_next() == '/') {
-                    while(peek() != '\n' && !is_at_end()) {
-                        advance();
-                    }
-                } else {
-                    return;
-                }
-                break;
-            default:
-                return;
-        }
+        scanner->current = skip_blanks(scanner->current, scanner->end, &scanner->line);
+        if(peek(scanner) != '/' || peek_next(scanner) != '/') return;
+
+        // A comment runs up to the newline, which the next pass counts.
+        scanner->current = find_byte(scanner->current, scanner->end, '\n', &scanner->line);
     }
 }
 
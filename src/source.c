@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "memory.h"
+#include "source.h"
+
+#define SOURCE_READ_SIZE 65536
+
+
+static void init_source(Source *source) {
+    source->text = "";
+    source->length = 0;
+    source->mapping = NULL;
+    source->buffer = NULL;
+}
+
+
+/* Loads path, or stdin when path is "-". Falls back to
+ * streaming for anything that cannot be mapped.
+ */
+bool open_source(Source *source, const char *path) {
+    init_source(source);
+    if(strcmp(path, "-") == 0) return read_source_stream(source, stdin);
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+
+    if(S_ISREG(info.st_mode)) {
+        if(info.st_size == 0) {
+            close(fd);
+            return true;
+        }
+        void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping != MAP_FAILED) {
+            close(fd);
+            posix_madvise(mapping, info.st_size, POSIX_MADV_SEQUENTIAL);
+            source->mapping = mapping;
+            source->text = mapping;
+            source->length = info.st_size;
+            return true;
+        }
+    }
+
+    FILE *stream = fdopen(fd, "rb");
+    if(stream == NULL) {
+        close(fd);
+        return false;
+    }
+    bool read = read_source_stream(source, stream);
+    fclose(stream);
+    return read;
+}
+
+
+bool read_source_stream(Source *source, FILE *stream) {
+    init_source(source);
+    size_t capacity = 0;
+    char *buffer = NULL;
+    for(;;) {
+        if(capacity - source->length < SOURCE_READ_SIZE) {
+            size_t grown = capacity < SOURCE_READ_SIZE ?
+                SOURCE_READ_SIZE : capacity * CHUNK_GROWTH_FACTOR;
+            buffer = reallocate(buffer, capacity, grown);
+            capacity = grown;
+        }
+        size_t bytes_read = fread(buffer + source->length, 1,
+            capacity - source->length, stream);
+        source->length += bytes_read;
+        if(bytes_read == 0) break;
+    }
+
+    // Trim the slack so the buffer is exactly length bytes.
+    if(buffer != NULL) buffer = reallocate(buffer, capacity, source->length);
+    source->buffer = buffer;
+    source->text = buffer != NULL ? buffer : "";
+    if(ferror(stream)) {
+        close_source(source);
+        return false;
+    }
+    return true;
+}
+
+
+void close_source(Source *source) {
+    if(source->mapping != NULL) munmap(source->mapping, source->length);
+    if(source->buffer != NULL) reallocate(source->buffer, source->length, 0);
+    init_source(source);
+}
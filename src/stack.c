@@ -8,6 +8,19 @@ void init_stack(Stack* stack) {
 }
 
 
+/* Grows the stack once so at least slots more values fit,
+ * letting callers push without checking capacity.
+ */
+void reserve_stack(Stack* stack, int slots) {
+    int used = stack->top - stack->data;
+    if(stack->size >= used + slots) return;
+
+    while(stack->size < used + slots) stack->size *= STACK_GROWTH_FACTOR;
+    stack->data = reallocate(stack->data, used * sizeof(Value), stack->size * sizeof(Value));
+    stack->top = stack->data + used;
+}
+
+
 void push(Stack* stack, Value value) {
     int used = stack->top - stack->data;
     if(stack->size < used + 1) {
@@ -0,0 +1,131 @@
+#include <string.h>
+#include "memory.h"
+#include "object.h"
+#include "table.h"
+
+
+void init_table(Table *table) {
+    table->count = 0;
+    table->capacity = 0;
+    table->entries = NULL;
+}
+
+
+void free_table(Table *table) {
+    reallocate(table->entries, table->capacity * sizeof(Entry), 0);
+    init_table(table);
+}
+
+
+/* Returns key's entry, or the entry to insert it in: the
+ * first tombstone on its probe sequence, if any.
+ */
+static Entry *find_entry(Entry *entries, int capacity, ObjString *key) {
+    uint32_t index = key->hash & (capacity - 1);
+    Entry *tombstone = NULL;
+    for(;;) {
+        Entry *entry = &entries[index];
+        if(entry->key == key) return entry;
+        if(entry->key == NULL) {
+            if(IS_NULL(entry->value)) return tombstone != NULL ? tombstone : entry;
+            if(tombstone == NULL) tombstone = entry;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+
+static void adjust_capacity(Table *table, int capacity) {
+    Entry *entries = reallocate(NULL, 0, capacity * sizeof(Entry));
+    for(int i = 0; i < capacity; i++) {
+        entries[i].key = NULL;
+        entries[i].value = NULL_VAL;
+    }
+
+    // Tombstones are dropped.
+    table->count = 0;
+    for(int i = 0; i < table->capacity; i++) {
+        Entry *entry = &table->entries[i];
+        if(entry->key == NULL) continue;
+        *find_entry(entries, capacity, entry->key) = *entry;
+        table->count += 1;
+    }
+
+    reallocate(table->entries, table->capacity * sizeof(Entry), 0);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+
+bool table_get(Table *table, ObjString *key, Value *value) {
+    if(table->count == 0) return false;
+    Entry *entry = find_entry(table->entries, table->capacity, key);
+    if(entry->key == NULL) return false;
+    *value = entry->value;
+    return true;
+}
+
+
+/* Returns true if key was not in the table before. */
+bool table_set(Table *table, ObjString *key, Value value) {
+    if(table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
+        adjust_capacity(table, table->capacity < INITIAL_TABLE_SIZE ?
+            INITIAL_TABLE_SIZE : table->capacity * TABLE_GROWTH_FACTOR);
+    }
+
+    Entry *entry = find_entry(table->entries, table->capacity, key);
+    bool is_new = entry->key == NULL;
+    if(is_new && IS_NULL(entry->value)) table->count += 1;
+    entry->key = key;
+    entry->value = value;
+    return is_new;
+}
+
+
+/* Returns true if key was in the table. */
+bool table_delete(Table *table, ObjString *key) {
+    if(table->count == 0) return false;
+    Entry *entry = find_entry(table->entries, table->capacity, key);
+    if(entry->key == NULL) return false;
+    entry->key = NULL;
+    entry->value = BOOL_VAL(true);
+    return true;
+}
+
+
+/* Finds the key whose characters are chars[0..length), the
+ * one lookup that compares contents. Used for interning.
+ */
+ObjString *table_find_string(const Table *table, const char *chars, size_t length, uint32_t hash) {
+    if(table->count == 0) return NULL;
+    uint32_t index = hash & (table->capacity - 1);
+    for(;;) {
+        Entry *entry = &table->entries[index];
+        ObjString *key = entry->key;
+        if(key == NULL) {
+            if(IS_NULL(entry->value)) return NULL;
+        } else if(key->hash == hash && key->length == length &&
+            memcmp(key->chars, chars, length) == 0) return key;
+        index = (index + 1) & (table->capacity - 1);
+    }
+}
+
+
+/* Finds the key equal to a followed by b without building
+ * the concatenation first.
+ */
+ObjString *table_find_concatenation(const Table *table, ObjString *a, ObjString *b, uint32_t hash) {
+    if(table->count == 0) return NULL;
+    size_t length = (size_t)a->length + b->length;
+    uint32_t index = hash & (table->capacity - 1);
+    for(;;) {
+        Entry *entry = &table->entries[index];
+        ObjString *key = entry->key;
+        if(key == NULL) {
+            if(IS_NULL(entry->value)) return NULL;
+        } else if(key->hash == hash && key->length == length &&
+            memcmp(key->chars, a->chars, a->length) == 0 &&
+            memcmp(key->chars + a->length, b->chars, b->length) == 0) return key;
+        index = (index + 1) & (table->capacity - 1);
+    }
+}
@@ -1,3 +1,6 @@
+#include <inttypes.h>
+#include <string.h>
+#include "object.h"
 #include "value.h"
 
 
@@ -11,11 +14,12 @@ void init_value_array(ValueArray *array) {
            have a count of memory in use.
     */
     array->values = NULL;
+    array->arena = NULL;
 }
 
 void free_value_array(ValueArray *array) {
     // Argument of old_size honestly doesn't matter...
-    reallocate(array->values, sizeof(Value) * array->capacity, 0);
+    arena_reallocate(array->arena, array->values, sizeof(Value) * array->capacity, 0);
     init_value_array(array);
 }
 
@@ -27,7 +31,7 @@ void write_value_array(ValueArray *array, Value value) {
         array->capacity = (array->capacity < INITIAL_CHUNK_SIZE) ?
             INITIAL_CHUNK_SIZE : array->capacity * CHUNK_GROWTH_FACTOR;
         
-        array->values = reallocate(array->values, array->count * sizeof(Value),
+        array->values = arena_reallocate(array->arena, array->values, array->count * sizeof(Value),
             array->capacity * sizeof(Value));
     }
 
@@ -35,17 +39,103 @@ void write_value_array(ValueArray *array, Value value) {
     array->count += 1;
 }
 
-void print_value(Value value) {
-    switch(value.type) {
-        case VAL_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false");
-            break;
-        case VAL_NULL:
-            printf("null");
-            break;
+/* A double with no fraction that an int could hold prints
+ * its digits, like an int of the same value, so a result
+ * prints the same whether it fit an int or overflowed to a
+ * double. -0 keeps its sign. Anything else prints with %g.
+ */
+static void print_double(FILE *out, double value) {
+    if(value > -0x1p63 && value < 0x1p63 && value == (double)(int64_t)value) {
+        fprintf(out, "%.0f", value);
+    } else {
+        fprintf(out, "%g", value);
+    }
+}
+
+
+void print_value(FILE *out, Value value) {
+    if(IS_BOOL(value)) {
+        fputs(AS_BOOL(value) ? "true" : "false", out);
+    } else if(IS_NULL(value)) {
+        fputs("null", out);
+    } else if(IS_INT(value)) {
+        fprintf(out, "%" PRId64, AS_INT(value));
+    } else if(IS_DOUBLE(value)) {
+        print_double(out, AS_DOUBLE(value));
+    } else if(IS_OBJ(value)) {
+        print_object(out, value);
+    }
+}
+
+
+/* Numbers are equal by value, so 1 == 1.0. Objects are
+ * equal only to themselves; strings are interned, so that
+ * is equality of contents.
+ */
+bool values_equal(Value a, Value b) {
+    if(IS_INT(a) && IS_INT(b)) return AS_INT(a) == AS_INT(b);
+    #ifdef NAN_BOXING
+    /* Compare numbers as doubles so NaN != NaN and 0 == -0. */
+    if(IS_NUMBER(a) && IS_NUMBER(b)) return AS_NUMBER(a) == AS_NUMBER(b);
+    return a == b;
+    #else
+    if(IS_NUMBER(a) && IS_NUMBER(b)) return AS_NUMBER(a) == AS_NUMBER(b);
+    if(a.type != b.type) return false;
+    switch (a.type) {
+        case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
+        case VAL_NULL: return true;
+        case VAL_OBJ: return AS_OBJ(a) == AS_OBJ(b);
+        default: return false;
+    }
+    #endif
+}
+
+
+
+/* Bitwise identity, used to share constant pool slots.
+ * Unlike values_equal(), 0 and -0 are distinct, as are 1
+ * and 1.0, and a NaN is identical to a NaN with the same
+ * bits.
+ */
+bool values_identical(Value a, Value b) {
+    #ifdef NAN_BOXING
+    return a == b;
+    #else
+    if(a.type != b.type) return false;
+    switch (a.type) {
+        case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
+        case VAL_NULL: return true;
         case VAL_NUMBER:
-            printf("%g", AS_NUMBER(value));
-            break;
+            return memcmp(&a.as.number, &b.as.number, sizeof(double)) == 0;
+        case VAL_INT: return AS_INT(a) == AS_INT(b);
+        case VAL_OBJ: return AS_OBJ(a) == AS_OBJ(b);
+        default: return false;
     }
-    
-}
\ No newline at end of file
+    #endif
+}
+
+
+/* Hash consistent with values_identical(). */
+uint32_t hash_value(Value value) {
+    uint64_t bits;
+    #ifdef NAN_BOXING
+    bits = value;
+    #else
+    switch (value.type) {
+        case VAL_BOOL: bits = AS_BOOL(value); break;
+        case VAL_NUMBER: memcpy(&bits, &value.as.number, sizeof(double)); break;
+        case VAL_INT: bits = (uint64_t)AS_INT(value); break;
+        case VAL_OBJ: bits = (uint64_t)(uintptr_t)AS_OBJ(value); break;
+        default: bits = 0; break;
+    }
+    bits ^= (uint64_t)value.type << 56;
+    #endif
+
+    /* 64-bit finalizer from MurmurHash3. */
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    bits *= 0xc4ceb9fe1a85ec53ULL;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
@@ -2,23 +2,17 @@
 #include <stdio.h>
 #include "vm.h"
 #include "compiler.h"
+#include "memory.h"
 #include "value.h"
+#include "profile.h"
 
-static VM vm;
-static double add(double a, double b);
-static double subtract(double a, double b);
-static double multiply(double a, double b);
-static double divide(double a, double b);
-static double less(double a, double b);
-static double greater(double a, double b);
-static uint8_t read_byte();
-static Value read_constant();
-static Value read_constant_long();
-static InterpretResult binary_op(ValueType type, double (*op)(double, double));
-static InterpretResult run();
-static void runtime_error(const char* format, ...);
-static bool is_falsey(Value value);
-static bool values_equal(Value a, Value b);
+static InterpretResult run(VM *vm, Value *result);
+static void runtime_error(VM *vm, const char* format, ...);
+static void undefined_variable(VM *vm, int slot);
+static void step_collector(VM *vm);
+static bool hooks_enabled(VM *vm);
+static void instruction_hook(VM *vm);
+static void trace_instruction(VM *vm);
 
 /* Starts up the virtual machine.
  * First it creates a chunk and then writes bytecode
@@ -26,237 +20,420 @@ static bool values_equal(Value a, Value b);
  * scanner and parser. Finally, it passes the bytecode
  * chunk into the virtual machine for interpretation.
  */
-InterpretResult interpret(const char* source) {
+InterpretResult interpret(VM *vm, const char* source, size_t length) {
     Chunk chunk;
-    init_chunk(&chunk);
-    if(!compile(source, &chunk)) {
-        free_chunk(&chunk);
-        return INTERPRET_COMPILE_ERROR;
+    init_chunk_in_arena(&chunk, &vm->arena);
+    InterpretResult result = INTERPRET_COMPILE_ERROR;
+    if(compile(source, length, &chunk, &vm->heap, &vm->global_names, vm->errors)) {
+        result = interpret_chunk(vm, &chunk);
     }
-    
-    vm.chunk = &chunk;
-    vm.ip = vm.chunk->code;
 
-    InterpretResult result = run();
     free_chunk(&chunk);
+    reset_arena(&vm->arena);
     return result;
 }
 
 
-/* The heart of the virtual machine.
- * Reads the instruction byte code byte-by-byte
- * and evaluates using a stack.
+/* Runs an already compiled chunk and prints the value it
+ * returns to vm->out. The chunk stays owned by the caller,
+ * so it can be executed again.
  */
-static InterpretResult run() {
-    #ifdef DEBUG_TRACE_EXECUTION
-        printf("\n===== stack trace =====");
-    #endif
-    for(;;) {
-        #ifdef DEBUG_TRACE_EXECUTION
-        printf("    ");
-        for(Value *slot = vm.stack.data; slot < vm.stack.top; slot++) {
-            printf("[ ");
-            print_value(*slot);
-            printf(" ]");
-        }
-        printf("\n");
-        disassemble_instruction(vm.chunk, (int)(vm.ip - vm.chunk->code));
-        #endif
-
-        uint8_t instruction;
-        switch(instruction = read_byte()) {
-            case OP_CONSTANT: {
-                Value constant = read_constant();
-                push(&vm.stack, constant);
-                break;
-            }
-            case OP_CONSTANT_LONG: {
-                Value constant = read_constant_long();
-                push(&vm.stack, constant);
-                break;
-            }
-            case OP_NEGATE: {
-                if(!IS_NUMBER(peek(&vm.stack, 0))) {
-                    runtime_error("Operand must be a number.");
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                push(&vm.stack, NUMBER_VAL(-AS_NUMBER(pop(&vm.stack))));
-                break;
-            }
-            case OP_ADD: { 
-                if(binary_op(VAL_NUMBER, &add) == INTERPRET_RUNTIME_ERROR)
-                    return INTERPRET_RUNTIME_ERROR;
-                break;
-            }
-            case OP_SUBTRACT: {
-                if(binary_op(VAL_NUMBER, &subtract) == INTERPRET_RUNTIME_ERROR)
-                    return INTERPRET_RUNTIME_ERROR;
-                break;
-            }
-            case OP_MULTIPLY: {
-                if(binary_op(VAL_NUMBER, &multiply) == INTERPRET_RUNTIME_ERROR)
-                    return INTERPRET_RUNTIME_ERROR;
-                break;
-            }
-            case OP_DIVIDE: {
-                if(binary_op(VAL_NUMBER, &divide) == INTERPRET_RUNTIME_ERROR)
-                    return INTERPRET_RUNTIME_ERROR;
-                break;
-            }
-            case OP_NULL: {
-                push(&vm.stack, NULL_VAL);
-                break;
-            }
-            case OP_TRUE: {
-                push(&vm.stack, BOOL_VAL(true));
-                break;
-            }
-            case OP_FALSE: {
-                push(&vm.stack, BOOL_VAL(false));
-                break;
-            }
-            case OP_NOT: {
-                push(&vm.stack, BOOL_VAL(is_falsey(pop(&vm.stack))));
-                break;
-            }
-            case OP_EQUAL: {
-                Value b = pop(&vm.stack);
-                Value a = pop(&vm.stack);
-                push(&vm.stack, BOOL_VAL(values_equal(a, b)));
-                break;
-            }
-            case OP_GREATER: {
-                if(binary_op(VAL_BOOL, &greater) == INTERPRET_RUNTIME_ERROR)
-                    return INTERPRET_RUNTIME_ERROR;
-                break;
-            }
-            case OP_LESS: {
-                if(binary_op(VAL_BOOL, &less) == INTERPRET_RUNTIME_ERROR)
-                    return INTERPRET_RUNTIME_ERROR;
-                break;
-            }
-            case OP_RETURN: {
-                print_value(pop(&vm.stack));
-                printf("\n");
-                return INTERPRET_OK;
-            }
-        }
+InterpretResult interpret_chunk(VM *vm, Chunk *chunk) {
+    Value value;
+    InterpretResult result = run_chunk(vm, chunk, &value);
+    if(result == INTERPRET_OK) {
+        print_value(vm->out, value);
+        fputc('\n', vm->out);
     }
+    return result;
 }
 
 
-static void runtime_error(const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    vfprintf(stderr, format, args);
-    va_end(args);
-    fputs("\n", stderr);
-
-    size_t instruction = vm.ip - vm.chunk->code - 1;
-    int line = get_line(vm.chunk, instruction);
-    fprintf(stderr, "[line %d] in script\n", line);
-    // free_stack(&vm.stack); Currently freed at end.
+/* Runs a chunk and stores the value it returns in result.
+ * The chunk is only read, so one chunk may run on several
+ * VMs at once.
+ */
+InterpretResult run_chunk(VM *vm, Chunk *chunk, Value *result) {
+    vm->chunk = chunk;
+    vm->ip = vm->chunk->code;
+    vm->stack.top = vm->stack.data;
+    reserve_stack(&vm->stack, chunk->max_stack);
+    reserve_globals(vm, chunk->global_count);
+    restart_constant_scan(&vm->heap);
+    if(vm->profile != NULL) profile_start_run(vm->profile);
+
+    InterpretResult status = run(vm, result);
+    vm->chunk = NULL;
+    return status;
 }
 
 
-static bool is_falsey(Value value) {
-    return IS_NULL(value) || 
-        (IS_BOOL(value) && !AS_BOOL(value)) ||
-        (IS_NUMBER(value) && AS_NUMBER(value) == 0);
+/* Collects opcode and opcode-pair counts into profile on
+ * every later run, or stops collecting when it is NULL.
+ */
+void set_vm_profile(VM *vm, Profile *profile) {
+    vm->profile = profile;
 }
 
-void init_vm() {
-    init_stack(&vm.stack);
-    vm.chunk = NULL;
-}
+
+/* run() keeps the instruction pointer and stack top in
+ * locals. The stack is reserved to the chunk's max_stack
+ * and the globals to its global_count before run() starts,
+ * so pushes and global slots need no capacity check.
+ * SYNC_STATE() writes both back for code that reads the VM.
+ */
+#define READ_BYTE()     (*ip++)
+#define READ_SHORT()    (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_CONSTANT() (vm->chunk->constants.values[READ_BYTE()])
+#define READ_CONSTANT_LONG() (vm->chunk->constants.values[READ_SHORT()])
+#define PUSH(value)     (*stack_top++ = (value))
+#define POP()           (*--stack_top)
+#define PEEK(depth)     (stack_top[-1 - (depth)])
+#define SYNC_STATE()    (vm->ip = ip, vm->stack.top = stack_top)
+
+/* Arithmetic and comparison handlers are expanded inline so
+ * every opcode gets its own type check and native operator.
+ */
+#define BINARY_OP(value_type, op) \
+    do { \
+        if(!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) { \
+            SYNC_STATE(); \
+            runtime_error(vm, "Operands must be numbers."); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+        double b = AS_NUMBER(POP()); \
+        double a = AS_NUMBER(POP()); \
+        PUSH(value_type(a op b)); \
+    } while(false)
+
+/* Two ints take the integer path; anything else, including
+ * an int result that does not fit, goes through doubles.
+ */
+#define ARITHMETIC_OP(int_op, op) \
+    do { \
+        Value b = PEEK(0); \
+        Value a = PEEK(1); \
+        int64_t value; \
+        if(IS_INT(a) && IS_INT(b) && int_op(AS_INT(a), AS_INT(b), &value)) { \
+            stack_top -= 1; \
+            PEEK(0) = INT_VAL(value); \
+            break; \
+        } \
+        BINARY_OP(NUMBER_VAL, op); \
+    } while(false)
+
+#define COMPARISON_OP(op) \
+    do { \
+        if(IS_INT(PEEK(0)) && IS_INT(PEEK(1))) { \
+            int64_t b = AS_INT(POP()); \
+            int64_t a = AS_INT(POP()); \
+            PUSH(BOOL_VAL(a op b)); \
+            break; \
+        } \
+        BINARY_OP(BOOL_VAL, op); \
+    } while(false)
+
+#define EQUALITY_OP(equal) \
+    do { \
+        Value b = POP(); \
+        Value a = POP(); \
+        PUSH(BOOL_VAL(values_equal(a, b) == (equal))); \
+    } while(false)
+
+/* The body of each opcode's handler, without the dispatch,
+ * so a superinstruction can run two of them back to back.
+ */
+#define DO_OP_CONSTANT()        PUSH(READ_CONSTANT())
+#define DO_OP_CONSTANT_LONG()   PUSH(READ_CONSTANT_LONG())
+#define DO_OP_NEGATE() \
+    do { \
+        if(!IS_NUMBER(PEEK(0))) { \
+            SYNC_STATE(); \
+            runtime_error(vm, "Operand must be a number."); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+        int64_t negated; \
+        if(IS_INT(PEEK(0)) && int_negate(AS_INT(PEEK(0)), &negated)) { \
+            PEEK(0) = INT_VAL(negated); \
+        } else { \
+            PEEK(0) = NUMBER_VAL(-AS_NUMBER(PEEK(0))); \
+        } \
+    } while(false)
+#define DO_OP_ADD() \
+    do { \
+        if(IS_NUMBER(PEEK(0)) && IS_NUMBER(PEEK(1))) { \
+            ARITHMETIC_OP(int_add, +); \
+        } else if(IS_STRING(PEEK(0)) && IS_STRING(PEEK(1))) { \
+            if(vm->heap.bytes_allocated >= vm->heap.gc.next_step) { \
+                SYNC_STATE(); \
+                step_collector(vm); \
+            } \
+            ObjString *string = concatenate_strings(&vm->heap, \
+                AS_STRING(PEEK(1)), AS_STRING(PEEK(0))); \
+            stack_top -= 1; \
+            PEEK(0) = OBJ_VAL(string); \
+        } else { \
+            SYNC_STATE(); \
+            runtime_error(vm, "Operands must be two numbers or two strings."); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+    } while(false)
+#define DO_OP_SUBTRACT()        ARITHMETIC_OP(int_subtract, -)
+#define DO_OP_MULTIPLY()        ARITHMETIC_OP(int_multiply, *)
+#define DO_OP_DIVIDE()          ARITHMETIC_OP(int_divide, /)
+#define DO_OP_NULL()            PUSH(NULL_VAL)
+#define DO_OP_TRUE()            PUSH(BOOL_VAL(true))
+#define DO_OP_FALSE()           PUSH(BOOL_VAL(false))
+#define DO_OP_NOT()             (PEEK(0) = BOOL_VAL(is_falsey(PEEK(0))))
+#define DO_OP_EQUAL()           EQUALITY_OP(true)
+#define DO_OP_GREATER()         COMPARISON_OP(>)
+#define DO_OP_LESS()            COMPARISON_OP(<)
+#define DO_OP_GREATER_EQUAL()   COMPARISON_OP(>=)
+#define DO_OP_LESS_EQUAL()      COMPARISON_OP(<=)
+#define DO_OP_NOT_EQUAL()       EQUALITY_OP(false)
+#define DO_OP_POP()             ((void)POP())
+/* A global slot the collector has already marked may be
+ * given an object it has not, so stores mark while marking.
+ */
+#define WRITE_GLOBAL(slot, value) \
+    do { \
+        if(vm->heap.gc.phase == GC_MARK) mark_value(&vm->heap, value); \
+        globals[slot] = (value); \
+    } while(false)
+#define DO_OP_DEFINE_GLOBAL()   WRITE_GLOBAL(READ_SHORT(), POP())
+#define DO_OP_GET_GLOBAL() \
+    do { \
+        uint16_t slot = READ_SHORT(); \
+        if(IS_UNDEFINED(globals[slot])) { \
+            SYNC_STATE(); \
+            undefined_variable(vm, slot); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+        PUSH(globals[slot]); \
+    } while(false)
+#define DO_OP_SET_GLOBAL() \
+    do { \
+        uint16_t slot = READ_SHORT(); \
+        if(IS_UNDEFINED(globals[slot])) { \
+            SYNC_STATE(); \
+            undefined_variable(vm, slot); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+        WRITE_GLOBAL(slot, PEEK(0)); \
+    } while(false)
+#define DO_OP_GET_LOCAL()       PUSH(slots[READ_BYTE()])
+#define DO_OP_SET_LOCAL()       (slots[READ_BYTE()] = PEEK(0))
+#define DO_OP_POPN()            (stack_top -= READ_BYTE())
+#define DO_OP_RETURN() \
+    do { \
+        *result = POP(); \
+        SYNC_STATE(); \
+        return INTERPRET_OK; \
+    } while(false)
+
+/* Instruction dispatch. With COMPUTED_GOTO every handler
+ * ends in its own indirect jump through a dispatch table,
+ * which gives the branch predictor one site per opcode
+ * instead of a single shared switch. Without it the
+ * handlers are plain switch cases.
+ *
+ * Tracing and profiling run through instruction_hook(vm).
+ * With COMPUTED_GOTO, run() dispatches through hook_table
+ * when a hook is on, whose entries all lead to the hook and
+ * then to the real handler, so the handlers carry no check
+ * at all. The switch loop tests a local flag instead.
+ */
+#ifdef COMPUTED_GOTO
+#define DISPATCH_LOOP       DISPATCH();
+#define CASE(op)            do_##op:
+#define DISPATCH()          goto *dispatch[READ_BYTE()]
+#else
+#define DISPATCH_LOOP \
+    for(;;) switch(hooked ? (SYNC_STATE(), instruction_hook(vm), READ_BYTE()) : READ_BYTE())
+#define CASE(op)            case op:
+#define DISPATCH()          break
+#endif
 
 
-void free_vm() {
-    free_stack(&vm.stack);
-    if(vm.chunk == NULL) return;
-    free_chunk(vm.chunk);
+/* The heart of the virtual machine.
+ * Reads the instruction byte code byte-by-byte
+ * and evaluates using a stack.
+ */
+static InterpretResult run(VM *vm, Value *result) {
+    #ifdef COMPUTED_GOTO
+    static void *dispatch_table[] = {
+    #define OPCODE(name, operand) [name] = &&do_##name,
+    #include "opcodes.def"
+    #undef OPCODE
+    #define SUPERINSTRUCTION(name, first, second, operand) [name] = &&do_##name,
+    #include "superinstructions.h"
+    #undef SUPERINSTRUCTION
+    };
+    // Neither table is ever written, so VMs on other threads share them.
+    static void *hook_table[] = {[0 ... OP_COUNT - 1] = &&do_hook};
+    void **dispatch = hooks_enabled(vm) ? hook_table : dispatch_table;
+    #else
+    bool hooked = hooks_enabled(vm);
+    #endif
+
+    uint8_t *ip = vm->ip;
+    Value *stack_top = vm->stack.top;
+    Value *globals = vm->globals;
+    Value *slots = vm->stack.data; // locals, numbered from the bottom
+
+    if(debug_options.trace_execution) printf("\n===== stack trace =====");
+    DISPATCH_LOOP {
+        #ifdef COMPUTED_GOTO
+        do_hook: {
+            ip -= 1;
+            SYNC_STATE();
+            instruction_hook(vm);
+            goto *dispatch_table[READ_BYTE()];
+        }
+        #endif
+        #define OPCODE(name, operand) CASE(name) { DO_##name(); DISPATCH(); }
+        #include "opcodes.def"
+        #undef OPCODE
+        #define SUPERINSTRUCTION(name, first, second, operand) \
+            CASE(name) { DO_##first(); DO_##second(); DISPATCH(); }
+        #include "superinstructions.h"
+        #undef SUPERINSTRUCTION
+    }
+    return INTERPRET_RUNTIME_ERROR;
 }
 
 
-static uint8_t read_byte() {
-    return *vm.ip++;
+static bool hooks_enabled(VM *vm) {
+    return debug_options.trace_execution || vm->profile != NULL;
 }
 
 
-static Value read_constant() {
-    uint8_t index = read_byte();
-    return vm.chunk->constants.values[index];
+/* Runs before each instruction while hooks are enabled,
+ * with vm->ip at the instruction and vm->stack in sync.
+ */
+static void instruction_hook(VM *vm) {
+    if(debug_options.trace_execution) trace_instruction(vm);
+    if(vm->profile != NULL) profile_instruction(vm->profile, *vm->ip);
 }
 
 
-static Value read_constant_long() {
-    uint16_t index = (read_byte() << 8) | read_byte();
-    return vm.chunk->constants.values[index];
+static void trace_instruction(VM *vm) {
+    printf("    ");
+    for(Value *slot = vm->stack.data; slot < vm->stack.top; slot++) {
+        printf("[ ");
+        print_value(stdout, *slot);
+        printf(" ]");
+    }
+    printf("\n");
+    disassemble_instruction(vm->chunk, (int)(vm->ip - vm->chunk->code));
 }
 
 
-static double add(double a, double b) {
+static void runtime_error(VM *vm, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(vm->errors, format, args);
+    va_end(args);
+    fputs("\n", vm->errors);
 
-    return a + b;
+    size_t instruction = vm->ip - vm->chunk->code - 1;
+    int line = get_line(vm->chunk, instruction);
+    fprintf(vm->errors, "[line %d] in script\n", line);
+    // free_stack(&vm->stack); Currently freed at end.
 }
 
 
-static double subtract(double a, double b) {
-    return a - b;
+/* Global slots carry no names at run time, so the name of
+ * one is looked up in the table of the code being run.
+ * Returns NULL for a slot the table does not name.
+ */
+ObjString *global_name(VM *vm, int slot) {
+    const Table *names = vm->running_names;
+    for(int i = 0; i < names->capacity; i++) {
+        Entry *entry = &names->entries[i];
+        if(entry->key != NULL && AS_INT(entry->value) == slot) return entry->key;
+    }
+    return NULL;
 }
 
 
-static double multiply(double a, double b) {
-    return a * b;
+static void undefined_variable(VM *vm, int slot) {
+    ObjString *name = global_name(vm, slot);
+    if(name != NULL) {
+        runtime_error(vm, "Undefined variable '%s'.", name->chars);
+    } else {
+        runtime_error(vm, "Undefined variable.");
+    }
 }
 
 
-static double divide(double a, double b) {
-    return a / b;
+/* Grows the globals to at least count slots. New slots are
+ * undefined until a var stores into them.
+ */
+void reserve_globals(VM *vm, int count) {
+    if(count <= vm->global_capacity) return;
+    int capacity = vm->global_capacity < INITIAL_GLOBALS_SIZE ?
+        INITIAL_GLOBALS_SIZE : vm->global_capacity;
+    while(capacity < count) capacity *= GLOBALS_GROWTH_FACTOR;
+    vm->globals = reallocate(vm->globals, vm->global_capacity * sizeof(Value),
+        capacity * sizeof(Value));
+    for(int i = vm->global_capacity; i < capacity; i++) vm->globals[i] = UNDEFINED_VAL;
+    vm->global_capacity = capacity;
 }
 
 
-static double greater(double a, double b) {
-    return a > b ? 1. : 0.;
+/* Takes one slice of a collection of vm's heap. The stack,
+ * the globals with their names and the running chunk's
+ * constants are the roots.
+ */
+static void step_collector(VM *vm) {
+    Roots roots;
+    roots.stack = vm->stack.data;
+    roots.stack_count = (int)(vm->stack.top - vm->stack.data);
+    roots.globals = vm->globals;
+    roots.global_count = vm->global_capacity;
+    roots.names = &vm->global_names;
+    roots.constants = vm->chunk != NULL ? &vm->chunk->constants : NULL;
+    collect_step(&vm->heap, &roots);
 }
 
 
-static double less(double a, double b) {
-    return a < b ? 1. : 0.;
+/* Forgets every global name and value. interpret() keeps
+ * them between calls otherwise, which the REPL relies on.
+ */
+void reset_globals(VM *vm) {
+    free_table(&vm->global_names);
+    for(int i = 0; i < vm->global_capacity; i++) vm->globals[i] = UNDEFINED_VAL;
 }
 
-static InterpretResult binary_op(ValueType type, double (*op)(double, double)) {
-    if(!IS_NUMBER(peek(&vm.stack, 0)) || !IS_NUMBER(peek(&vm.stack, 1))) {
-        runtime_error("Operands must be numbers.");
-        return INTERPRET_RUNTIME_ERROR;
-    }
-    double b = AS_NUMBER(pop(&vm.stack));
-    double a = AS_NUMBER(pop(&vm.stack));
+
+void init_vm(VM *vm) {
+    init_stack(&vm->stack);
+    init_arena(&vm->arena);
+    init_heap(&vm->heap);
+    init_table(&vm->global_names);
+    vm->running_names = &vm->global_names;
+    vm->globals = NULL;
+    vm->global_capacity = 0;
+    vm->chunk = NULL;
+    vm->profile = NULL;
+    vm->out = stdout;
+    vm->errors = stderr;
+}
 
 
-    switch(type) {
-        case VAL_BOOL: {
-            bool rv = (op(a, b) == 1 ? true : false);
-            push(&vm.stack, BOOL_VAL(rv));
-            return INTERPRET_OK;
-            break;
-        }
-        case VAL_NUMBER: {
-            push(&vm.stack, NUMBER_VAL(op(a, b)));
-            return INTERPRET_OK;
-            break;
-        }
-        default: return INTERPRET_RUNTIME_ERROR;
-    }
+void free_vm(VM *vm) {
+    free_stack(&vm->stack);
+    free_arena(&vm->arena);
+    free_heap(&vm->heap);
+    free_table(&vm->global_names);
+    vm->globals = reallocate(vm->globals, vm->global_capacity * sizeof(Value), 0);
+    vm->global_capacity = 0;
+    if(vm->chunk == NULL) return;
+    free_chunk(vm->chunk);
 }
 
 
-static bool values_equal(Value a, Value b) {
-    if(a.type != b.type) return false;
-    switch (a.type) {
-        case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
-        case VAL_NULL: return true;
-        case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
-        default: return false;
-    }
-}
\ No newline at end of file
+void print_vm_arena_report(VM *vm, FILE *out) {
+    print_arena_report(&vm->arena, "compile", out);
+}
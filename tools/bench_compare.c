@@ -0,0 +1,105 @@
+/* Benchmark comparison.
+ * Reads two result files written by make bench (a JSON
+ * array with one record per line, see bench/support/bench.h)
+ * and prints every metric found in both with its change.
+ * A metric that got worse by more than the threshold
+ * percentage is flagged, and the exit status is 1 if any
+ * was.
+ *
+ *   bench_compare BASE.json NEW.json [THRESHOLD]
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RECORDS 1024
+#define MAX_NAME 64
+
+typedef struct {
+    char bench[MAX_NAME];
+    char metric[MAX_NAME];
+    char unit[MAX_NAME];
+    double value;
+    bool higher_is_better;
+} Record;
+
+typedef struct {
+    Record records[MAX_RECORDS];
+    int count;
+} Results;
+
+
+static bool read_results(const char *path, Results *results) {
+    FILE *file = fopen(path, "r");
+    if(file == NULL) {
+        fprintf(stderr, "Could not open \"%s\".\n", path);
+        return false;
+    }
+
+    char line[512];
+    results->count = 0;
+    while(fgets(line, sizeof(line), file) != NULL && results->count < MAX_RECORDS) {
+        Record *record = &results->records[results->count];
+        char better[MAX_NAME];
+        int fields = sscanf(line,
+            " {\"bench\": \"%63[^\"]\", \"metric\": \"%63[^\"]\", \"value\": %lf, "
+            "\"unit\": \"%63[^\"]\", \"better\": \"%63[^\"]\"}",
+            record->bench, record->metric, &record->value, record->unit, better);
+        if(fields != 5) continue; // the array brackets
+        record->higher_is_better = strcmp(better, "higher") == 0;
+        results->count += 1;
+    }
+    fclose(file);
+    return true;
+}
+
+
+static const Record *find_record(const Results *results, const Record *key) {
+    for(int i = 0; i < results->count; i++) {
+        const Record *record = &results->records[i];
+        if(strcmp(record->bench, key->bench) == 0 &&
+            strcmp(record->metric, key->metric) == 0) return record;
+    }
+    return NULL;
+}
+
+
+int main(int argc, const char *argv[]) {
+    if(argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: bench_compare BASE.json NEW.json [THRESHOLD]\n");
+        return 64;
+    }
+    double threshold = argc == 4 ? atof(argv[3]) : 5.0;
+
+    static Results base;
+    static Results current;
+    if(!read_results(argv[1], &base) || !read_results(argv[2], &current)) return 74;
+
+    int regressions = 0;
+    printf("%-30s %12s %12s %8s\n", "metric", "base", "new", "change");
+    for(int i = 0; i < current.count; i++) {
+        const Record *record = &current.records[i];
+        const Record *old = find_record(&base, record);
+        char name[2 * MAX_NAME + 1];
+        snprintf(name, sizeof(name), "%s.%s", record->bench, record->metric);
+        if(old == NULL || old->value == 0) {
+            printf("%-30s %12s %12.4g %8s  %s\n", name, "-", record->value, "", record->unit);
+            continue;
+        }
+
+        double change = (record->value - old->value) / old->value * 100.0;
+        double worse = record->higher_is_better ? -change : change;
+        bool regressed = worse > threshold;
+        regressions += regressed;
+        printf("%-30s %12.4g %12.4g %+7.1f%%  %s%s\n", name, old->value,
+            record->value, change, record->unit, regressed ? "  REGRESSION" : "");
+    }
+
+    if(regressions > 0) {
+        printf("%d regression%s beyond %.1f%%.\n", regressions,
+            regressions == 1 ? "" : "s", threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Build throughput report.
+# Times each grino binary over the same scripts, running every
+# script RUNS times in one process (--repeat, cache off) so
+# startup is amortized, and prints milliseconds per run with
+# the speedup over the first binary.
+#
+#   build_report.sh RUNS NAME=BINARY... -- SCRIPT...
+
+runs=$1
+shift
+builds=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    builds="$builds $1"
+    shift
+done
+shift
+
+now() {
+    date +%s%N
+}
+
+printf "%-22s" "script"
+for build in $builds; do
+    printf " %15s" "${build%%=*}"
+done
+printf "\n"
+
+for script in "$@" total; do
+    printf "%-22s" "$(basename "$script")"
+    base=""
+    for build in $builds; do
+        binary=${build#*=}
+        if [ "$script" = total ]; then
+            elapsed=$(eval echo \$total_${build%%=*})
+        else
+            start=$(now)
+            "$binary" --no-cache --repeat="$runs" "$script" > /dev/null || exit 1
+            elapsed=$(( $(now) - start ))
+            eval total_${build%%=*}=\$\(\( \${total_${build%%=*}:-0} + $elapsed \)\)
+        fi
+        [ -z "$base" ] && base=$elapsed
+        awk -v t="$elapsed" -v b="$base" -v n="$runs" \
+            'BEGIN { printf " %7.2fms %s", t / n / 1e6, (t == b ? "    " : sprintf("%3.1fx", b / t)) }'
+    done
+    printf "\n"
+done
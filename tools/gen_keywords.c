@@ -0,0 +1,93 @@
+/* Keyword table generator.
+ * Packs every keyword in include/keywords.def into a
+ * zero-padded 64-bit word and searches for a multiplier
+ * that sends each word to its own slot of a power-of-two
+ * table under (word * multiplier) >> shift. Writes the
+ * table as a C header on stdout; the makefile runs it to
+ * produce obj/gen/keywords.h.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char *text;
+    const char *type;
+} KeywordSpec;
+
+static const KeywordSpec keywords[] = {
+#define KEYWORD(text, type) {text, #type},
+#include "keywords.def"
+#undef KEYWORD
+};
+
+#define KEYWORD_COUNT ((int)(sizeof(keywords) / sizeof(keywords[0])))
+#define MAX_TABLE_BITS 10
+#define TRIES_PER_SIZE 1000000
+
+static uint64_t pack(const char *text) {
+    uint64_t word = 0;
+    memcpy(&word, text, strlen(text));
+    return word;
+}
+
+
+/* Fills slots with keyword indices, or returns false on the
+ * first collision.
+ */
+static bool place_all(uint64_t multiplier, int bits, int *slots) {
+    int size = 1 << bits;
+    for(int i = 0; i < size; i++) slots[i] = -1;
+    for(int i = 0; i < KEYWORD_COUNT; i++) {
+        int slot = (pack(keywords[i].text) * multiplier) >> (64 - bits);
+        if(slots[slot] != -1) return false;
+        slots[slot] = i;
+    }
+    return true;
+}
+
+
+int main() {
+    for(int i = 0; i < KEYWORD_COUNT; i++) {
+        if(strlen(keywords[i].text) > sizeof(uint64_t)) {
+            fprintf(stderr, "gen_keywords: \"%s\" is longer than 8 bytes.\n",
+                keywords[i].text);
+            return 1;
+        }
+    }
+
+    static int slots[1 << MAX_TABLE_BITS];
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for(int bits = 1; bits <= MAX_TABLE_BITS; bits++) {
+        if((1 << bits) < KEYWORD_COUNT) continue;
+        for(int attempt = 0; attempt < TRIES_PER_SIZE; attempt++) {
+            // xorshift64; multipliers must be odd.
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            uint64_t multiplier = seed | 1;
+            if(!place_all(multiplier, bits, slots)) continue;
+
+            printf("/* Generated by tools/gen_keywords.c from include/keywords.def.\n"
+                " * Do not edit.\n */\n");
+            printf("#define KEYWORD_MAX_LENGTH 8\n");
+            printf("#define KEYWORD_HASH_MULTIPLIER 0x%016llxULL\n",
+                (unsigned long long)multiplier);
+            printf("#define KEYWORD_HASH_SHIFT %d\n\n", 64 - bits);
+            printf("static const Keyword keyword_table[%d] = {\n", 1 << bits);
+            for(int slot = 0; slot < (1 << bits); slot++) {
+                if(slots[slot] == -1) continue;
+                const KeywordSpec *keyword = &keywords[slots[slot]];
+                printf("    [%d] = {0x%016llxULL, %s}, // %s\n", slot,
+                    (unsigned long long)pack(keyword->text), keyword->type, keyword->text);
+            }
+            printf("};\n");
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "gen_keywords: no perfect hash with up to %d slots.\n",
+        1 << MAX_TABLE_BITS);
+    return 1;
+}
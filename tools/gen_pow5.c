@@ -0,0 +1,143 @@
+/* Power-of-five table generator.
+ * For every decimal exponent q in [-342, 308] writes the
+ * 128-bit significand of 5^q, normalized so its top bit is
+ * set: truncated for q >= 0, and a reciprocal rounded so it
+ * never underestimates for q < 0. src/number.c multiplies a
+ * decimal significand by these words (Eisel-Lemire). The
+ * big integers are only ever needed here, at build time.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SMALLEST_POWER -342
+#define LARGEST_POWER 308
+#define LIMBS 64 // 2048 bits, enough for 2^(2*795+128)
+
+typedef struct {
+    uint32_t limbs[LIMBS]; // least significant first
+} Big;
+
+static void set_small(Big *big, uint32_t value) {
+    memset(big, 0, sizeof(*big));
+    big->limbs[0] = value;
+}
+
+
+static void multiply_small(Big *big, uint32_t factor) {
+    uint64_t carry = 0;
+    for(int i = 0; i < LIMBS; i++) {
+        uint64_t product = (uint64_t)big->limbs[i] * factor + carry;
+        big->limbs[i] = (uint32_t)product;
+        carry = product >> 32;
+    }
+}
+
+
+static void shift_left_one(Big *big) {
+    for(int i = LIMBS - 1; i > 0; i--) {
+        big->limbs[i] = (big->limbs[i] << 1) | (big->limbs[i - 1] >> 31);
+    }
+    big->limbs[0] <<= 1;
+}
+
+
+static void shift_right_one(Big *big) {
+    for(int i = 0; i < LIMBS - 1; i++) {
+        big->limbs[i] = (big->limbs[i] >> 1) | (big->limbs[i + 1] << 31);
+    }
+    big->limbs[LIMBS - 1] >>= 1;
+}
+
+
+static int compare(const Big *left, const Big *right) {
+    for(int i = LIMBS - 1; i >= 0; i--) {
+        if(left->limbs[i] != right->limbs[i]) {
+            return left->limbs[i] < right->limbs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+
+static void subtract(Big *left, const Big *right) {
+    uint64_t borrow = 0;
+    for(int i = 0; i < LIMBS; i++) {
+        uint64_t difference = (uint64_t)left->limbs[i] - right->limbs[i] - borrow;
+        left->limbs[i] = (uint32_t)difference;
+        borrow = (difference >> 32) & 1;
+    }
+}
+
+
+static void add_one(Big *big) {
+    for(int i = 0; i < LIMBS && ++big->limbs[i] == 0; i++);
+}
+
+
+static int bit_length(const Big *big) {
+    for(int i = LIMBS - 1; i >= 0; i--) {
+        if(big->limbs[i] != 0) return i * 32 + 32 - __builtin_clz(big->limbs[i]);
+    }
+    return 0;
+}
+
+
+/* floor(2^exponent / divisor) by binary long division. */
+static void divide_power_of_two(Big *quotient, int exponent, const Big *divisor) {
+    Big remainder;
+    set_small(&remainder, 0);
+    set_small(quotient, 0);
+    for(int bit = exponent; bit >= 0; bit--) {
+        shift_left_one(&remainder);
+        if(bit == exponent) remainder.limbs[0] |= 1;
+        shift_left_one(quotient);
+        if(compare(&remainder, divisor) >= 0) {
+            subtract(&remainder, divisor);
+            quotient->limbs[0] |= 1;
+        }
+    }
+}
+
+
+static void print_entry(const Big *big, int q) {
+    // Callers leave exactly 128 significant bits.
+    uint64_t high = ((uint64_t)big->limbs[3] << 32) | big->limbs[2];
+    uint64_t low = ((uint64_t)big->limbs[1] << 32) | big->limbs[0];
+    printf("    0x%016llxULL, 0x%016llxULL, // 5^%d\n",
+        (unsigned long long)high, (unsigned long long)low, q);
+}
+
+
+int main() {
+    printf("/* Generated by tools/gen_pow5.c. Do not edit. */\n");
+    printf("#define SMALLEST_POWER_OF_FIVE %d\n", SMALLEST_POWER);
+    printf("#define LARGEST_POWER_OF_FIVE %d\n\n", LARGEST_POWER);
+    printf("static const uint64_t power_of_five_128[%d] = {\n",
+        2 * (LARGEST_POWER - SMALLEST_POWER + 1));
+
+    Big power;
+    Big value;
+    for(int q = SMALLEST_POWER; q < 0; q++) {
+        set_small(&power, 1);
+        for(int i = 0; i < -q; i++) multiply_small(&power, 5);
+        int z = bit_length(&power); // 2^(z-1) <= 5^-q < 2^z
+
+        // Reciprocal 2^b / 5^-q, rounded up, cut to 128 bits.
+        int b = q >= -27 ? z + 127 : 2 * z + 128;
+        divide_power_of_two(&value, b, &power);
+        add_one(&value);
+        while(bit_length(&value) > 128) shift_right_one(&value);
+        print_entry(&value, q);
+    }
+    for(int q = 0; q <= LARGEST_POWER; q++) {
+        set_small(&value, 1);
+        for(int i = 0; i < q; i++) multiply_small(&value, 5);
+        while(bit_length(&value) < 128) shift_left_one(&value);
+        while(bit_length(&value) > 128) shift_right_one(&value);
+        print_entry(&value, q);
+    }
+    printf("};\n");
+    return 0;
+}
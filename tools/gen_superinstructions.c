@@ -0,0 +1,132 @@
+/* Superinstruction generator.
+ * Reads an opcode-pair histogram in the format written by
+ * "grino --profile=FILE" (see src/profile.c) and picks the
+ * most frequent pairs worth fusing into one instruction:
+ * both halves base opcodes, neither OP_RETURN (it runs once
+ * per chunk), and the second taking no operand, so the
+ * fused instruction keeps the first one's operand. Writes
+ * them as SUPERINSTRUCTION(name, first, second, operand)
+ * entries on stdout; the makefile runs it to produce
+ * obj/gen/superinstructions.h.
+ *
+ *   gen_superinstructions PROFILE.json [COUNT]
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NAME 64
+#define MAX_PAIRS 1024
+#define DEFAULT_COUNT 8
+
+typedef struct {
+    const char *name;
+    const char *operand;
+} OpcodeSpec;
+
+static const OpcodeSpec opcodes[] = {
+#define OPCODE(name, operand) {#name, #operand},
+#include "opcodes.def"
+#undef OPCODE
+};
+
+#define OPCODE_COUNT ((int)(sizeof(opcodes) / sizeof(opcodes[0])))
+
+typedef struct {
+    int first;
+    int second;
+    unsigned long long count;
+} Pair;
+
+
+static int find_opcode(const char *name) {
+    for(int i = 0; i < OPCODE_COUNT; i++) {
+        if(strcmp(opcodes[i].name, name) == 0) return i;
+    }
+    return -1; // e.g. a superinstruction from a fused build
+}
+
+
+static bool fusable(int first, int second) {
+    if(first < 0 || second < 0) return false;
+    if(strcmp(opcodes[first].name, "OP_RETURN") == 0) return false;
+    if(strcmp(opcodes[second].name, "OP_RETURN") == 0) return false;
+    return strcmp(opcodes[second].operand, "OPERAND_NONE") == 0;
+}
+
+
+static int compare_pairs(const void *a, const void *b) {
+    const Pair *left = a;
+    const Pair *right = b;
+    if(left->count != right->count) return left->count < right->count ? 1 : -1;
+    if(left->first != right->first) return left->first - right->first;
+    return left->second - right->second;
+}
+
+
+/* 32-bit FNV-1a over the generated names, so bytecode
+ * caches written with another set are rejected.
+ */
+static uint32_t hash_name(uint32_t hash, const char *name) {
+    for(; *name != '\0'; name++) {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+int main(int argc, const char *argv[]) {
+    if(argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: gen_superinstructions PROFILE.json [COUNT]\n");
+        return 64;
+    }
+    int limit = argc == 3 ? atoi(argv[2]) : DEFAULT_COUNT;
+    FILE *file = fopen(argv[1], "r");
+    if(file == NULL) {
+        fprintf(stderr, "gen_superinstructions: could not open \"%s\".\n", argv[1]);
+        return 74;
+    }
+
+    static Pair pairs[MAX_PAIRS];
+    int pair_count = 0;
+    char line[512];
+    while(fgets(line, sizeof(line), file) != NULL && pair_count < MAX_PAIRS) {
+        char first[MAX_NAME];
+        char second[MAX_NAME];
+        unsigned long long count;
+        if(sscanf(line, " {\"first\": \"%63[^\"]\", \"second\": \"%63[^\"]\", \"count\": %llu}",
+            first, second, &count) != 3) continue;
+        Pair *pair = &pairs[pair_count];
+        pair->first = find_opcode(first);
+        pair->second = find_opcode(second);
+        pair->count = count;
+        if(fusable(pair->first, pair->second)) pair_count += 1;
+    }
+    fclose(file);
+    qsort(pairs, pair_count, sizeof(Pair), compare_pairs);
+    if(pair_count > limit) pair_count = limit;
+
+    char names[MAX_PAIRS][2 * MAX_NAME + 8];
+    uint32_t set = 2166136261u;
+    for(int i = 0; i < pair_count; i++) {
+        // OP_CONSTANT + OP_ADD becomes OP_CONSTANT_THEN_ADD; a
+        // plain join could clash, e.g. OP_NOT + OP_EQUAL.
+        snprintf(names[i], sizeof(names[i]), "%s_THEN_%s",
+            opcodes[pairs[i].first].name, opcodes[pairs[i].second].name + 3);
+        set = hash_name(set, names[i]);
+    }
+
+    printf("/* Generated by tools/gen_superinstructions.c from %s. Do not edit. */\n", argv[1]);
+    printf("#ifndef SUPERINSTRUCTION_SET\n");
+    printf("#define SUPERINSTRUCTION_SET 0x%08xu\n", set);
+    printf("#endif\n");
+    for(int i = 0; i < pair_count; i++) {
+        printf("SUPERINSTRUCTION(%s, %s, %s, %s) // %llu pairs\n", names[i],
+            opcodes[pairs[i].first].name, opcodes[pairs[i].second].name,
+            opcodes[pairs[i].first].operand, pairs[i].count);
+    }
+    return 0;
+}